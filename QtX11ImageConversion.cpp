@@ -18,52 +18,146 @@
  *
  */
 #include <QImage>
+#include <QtEndian>
+
+#include <cstring>
 
 #include "QtX11ImageConversion.h"
 
-QImage qimageFromXImage(XImage* xi)
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+namespace {
+
+#ifdef __SSE2__
+inline __m128i byteSwap32(__m128i v)
 {
-    QImage::Format format = QImage::Format_ARGB32_Premultiplied;
-    if (xi->depth == 24)
-        format = QImage::Format_RGB32;
-    else if (xi->depth == 16)
-        format = QImage::Format_RGB16;
+#ifdef __SSSE3__
+    return _mm_shuffle_epi8(v, _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+#else
+    // swap the bytes of each half, then the halves of each pixel
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+#endif
+}
 
-    QImage image = QImage(reinterpret_cast<uchar*>(xi->data), xi->width, xi->height, xi->bytes_per_line, format).copy();
+inline __m128i byteSwap16(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+#endif
 
-    // we may have to swap the byte order
-    if ((QSysInfo::ByteOrder == QSysInfo::LittleEndian && xi->byte_order == MSBFirst)
-        || (QSysInfo::ByteOrder == QSysInfo::BigEndian && xi->byte_order == LSBFirst)) {
-
-        for (int i = 0; i < image.height(); i++) {
-            if (xi->depth == 16) {
-                ushort* p = reinterpret_cast<ushort*>(image.scanLine(i));
-                ushort* end = p + image.width();
-                while (p < end) {
-                    *p = ((*p << 8) & 0xff00) | ((*p >> 8) & 0x00ff);
-                    p++;
-                }
-            } else {
-                uint* p = reinterpret_cast<uint*>(image.scanLine(i));
-                uint* end = p + image.width();
-                while (p < end) {
-                    *p = ((*p << 24) & 0xff000000) | ((*p << 8) & 0x00ff0000)
-                         | ((*p >> 8) & 0x0000ff00) | ((*p >> 24) & 0x000000ff);
-                    p++;
-                }
-            }
-        }
+// copies a line of 32 bit pixels, swapping the byte order and or-ing the alpha in the same pass,
+// src and dst may be the same line
+void convertLine32(const uchar *src, uchar *dst, int width, bool swap, quint32 alpha)
+{
+    int x = 0;
+
+#ifdef __SSE2__
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(alpha));
+    for (; x + 4 <= width; x += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        if (swap)
+            v = byteSwap32(v);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_or_si128(v, alphaMask));
+    }
+#endif
+
+    for (; x < width; ++x) {
+        quint32 p;
+        memcpy(&p, src + x * 4, 4);
+        if (swap)
+            p = qbswap(p);
+        p |= alpha;
+        memcpy(dst + x * 4, &p, 4);
+    }
+}
+
+// same as convertLine32 for 16 bit pixels, there is no alpha
+void convertLine16(const uchar *src, uchar *dst, int width, bool swap)
+{
+    if (!swap) {
+        if (src != dst)
+            memcpy(dst, src, width * 2);
+        return;
     }
 
+    int x = 0;
+
+#ifdef __SSE2__
+    for (; x + 8 <= width; x += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 2), byteSwap16(v));
+    }
+#endif
+
+    for (; x < width; ++x) {
+        quint16 p;
+        memcpy(&p, src + x * 2, 2);
+        p = qbswap(p);
+        memcpy(dst + x * 2, &p, 2);
+    }
+}
+
+QImage::Format formatForDepth(int depth)
+{
+    if (depth == 24)
+        return QImage::Format_RGB32;
+    else if (depth == 16)
+        return QImage::Format_RGB16;
+    return QImage::Format_ARGB32_Premultiplied;
+}
+
+// converts the pixels from src into dst, both may be the same buffer
+void convertPixels(const uchar *src, int srcBytesPerLine, uchar *dst, int dstBytesPerLine,
+                   int width, int height, int depth, int byteOrder)
+{
+    // we may have to swap the byte order
+    const bool swap = (QSysInfo::ByteOrder == QSysInfo::LittleEndian && byteOrder == MSBFirst)
+        || (QSysInfo::ByteOrder == QSysInfo::BigEndian && byteOrder == LSBFirst);
+
     // fix-up alpha channel
-    if (format == QImage::Format_RGB32) {
-        QRgb* p = reinterpret_cast<QRgb*>(image.bits());
-        for (int y = 0; y < xi->height; ++y) {
-            for (int x = 0; x < xi->width; ++x)
-                p[x] |= 0xff000000;
-            p += xi->bytes_per_line / 4;
-        }
+    const quint32 alpha = formatForDepth(depth) == QImage::Format_RGB32 ? 0xff000000 : 0;
+
+    for (int y = 0; y < height; ++y) {
+        const uchar *in = src + y * srcBytesPerLine;
+        uchar *out = dst + y * dstBytesPerLine;
+
+        if (depth == 16)
+            convertLine16(in, out, width, swap);
+        else if (swap || alpha != 0 || in != out)
+            convertLine32(in, out, width, swap, alpha);
     }
+}
+
+}
 
+QImage qimageFromXImage(XImage* xi)
+{
+    return qimageFromXImageData(reinterpret_cast<const uchar*>(xi->data), xi->width, xi->height,
+                                xi->bytes_per_line, xi->depth, xi->byte_order);
+}
+
+QImage qimageFromXImageData(const uchar *data, int width, int height, int bytesPerLine, int depth, int byteOrder)
+{
+    // the copy, the byte swap and the alpha fix-up are done in a single pass
+    QImage image(width, height, formatForDepth(depth));
+    if (image.isNull())
+        return image;
+
+    convertPixels(data, bytesPerLine, image.bits(), image.bytesPerLine(), width, height, depth, byteOrder);
     return image;
 }
+
+QImage qimageFromXImageInPlace(XImage* xi)
+{
+    auto data = reinterpret_cast<uchar*>(xi->data);
+    convertPixels(data, xi->bytes_per_line, data, xi->bytes_per_line, xi->width, xi->height, xi->depth, xi->byte_order);
+
+    return QImage(data, xi->width, xi->height, xi->bytes_per_line, formatForDepth(xi->depth));
+}
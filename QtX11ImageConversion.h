@@ -26,4 +26,12 @@
 
 QImage qimageFromXImage(XImage*);
 
+// Same as qimageFromXImage, for ZPixmap data not owned by an XImage (e.g. xcb replies)
+QImage qimageFromXImageData(const uchar *data, int width, int height, int bytesPerLine, int depth, int byteOrder);
+
+// Converts the pixels of an XImage owned by the caller in place and wraps them without a copy,
+// the image is valid as long as the XImage is. The XImage keeps its byte order, so it must be
+// converted once after each read
+QImage qimageFromXImageInPlace(XImage*);
+
 #endif 
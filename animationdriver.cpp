@@ -0,0 +1,155 @@
+#include "animationdriver.h"
+
+#include <KDecoration2/Decoration>
+
+#include <QGuiApplication>
+#include <QHash>
+#include <QScreen>
+
+#include <algorithm>
+
+
+namespace Breeze
+{
+    namespace
+    {
+        const int g_defaultFrameInterval = 16;
+
+        float inOutQuad(float t)
+        {
+            return t < 0.5f ? 2 * t * t : 1 - (2 - 2 * t) * (2 - 2 * t) / 2;
+        }
+
+        // One tick per frame of the primary screen
+        int frameInterval()
+        {
+            auto screen = QGuiApplication::primaryScreen();
+            if (screen == nullptr || screen->refreshRate() <= 1)
+                return g_defaultFrameInterval;
+
+            return qMax(1, qRound(1000 / screen->refreshRate()));
+        }
+    }
+
+    AnimationDriver *AnimationDriver::self()
+    {
+        static AnimationDriver s_self;
+        return &s_self;
+    }
+
+    AnimationDriver::AnimationDriver()
+    {
+        m_timer.setTimerType(Qt::PreciseTimer);
+        QObject::connect(&m_timer, &QTimer::timeout, &m_timer, [this]() { tick(); });
+    }
+
+    int AnimationDriver::acquire(KDecoration2::Decoration *decoration, Apply apply, qreal value)
+    {
+        int handle;
+        if (!m_free.empty())
+        {
+            handle = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            handle = static_cast<int>(m_values.size());
+            m_values.push_back(0);
+            m_progress.push_back(0);
+            m_rates.push_back(0);
+            m_directions.push_back(0);
+            m_decorations.push_back(nullptr);
+            m_apply.emplace_back();
+        }
+
+        const auto i = static_cast<size_t>(handle);
+        m_progress[i] = qBound(0.0f, static_cast<float>(value), 1.0f);
+        m_values[i] = inOutQuad(m_progress[i]);
+        m_rates[i] = 0;
+        m_directions[i] = 0;
+        m_decorations[i] = decoration;
+        m_apply[i] = std::move(apply);
+        return handle;
+    }
+
+    void AnimationDriver::release(int handle)
+    {
+        const auto i = static_cast<size_t>(handle);
+        m_directions[i] = 0;
+        m_decorations[i] = nullptr;
+        m_apply[i] = nullptr;
+        m_running.erase(std::remove(m_running.begin(), m_running.end(), handle), m_running.end());
+        m_free.push_back(handle);
+
+        if (m_running.empty())
+            m_timer.stop();
+    }
+
+    void AnimationDriver::setDuration(int handle, int duration)
+    {
+        m_rates[static_cast<size_t>(handle)] = duration > 0 ? 1.0f / static_cast<float>(duration) : 1.0f;
+    }
+
+    bool AnimationDriver::start(int handle, bool forward)
+    {
+        const auto i = static_cast<size_t>(handle);
+        const signed char direction = forward ? 1 : -1;
+
+        // Already there
+        if (m_directions[i] == 0 && m_progress[i] == (forward ? 1.0f : 0.0f))
+            return false;
+
+        if (m_directions[i] == 0)
+            m_running.push_back(handle);
+        m_directions[i] = direction;
+
+        if (!m_timer.isActive())
+        {
+            m_clock.start();
+            m_timer.start(frameInterval());
+        }
+
+        return true;
+    }
+
+    void AnimationDriver::tick()
+    {
+        const float elapsed = static_cast<float>(m_clock.restart());
+
+        // Advance every running transition in a single pass over the flat arrays
+        QHash<KDecoration2::Decoration *, QRegion> dirty;
+        for (size_t n = 0; n < m_running.size();)
+        {
+            const auto i = static_cast<size_t>(m_running[n]);
+            const float progress = qBound(0.0f, m_progress[i] + m_directions[i] * m_rates[i] * elapsed, 1.0f);
+
+            m_progress[i] = progress;
+            m_values[i] = inOutQuad(progress);
+
+            // Stop at the ends, the last value is still applied below
+            const bool finished = progress == (m_directions[i] > 0 ? 1.0f : 0.0f);
+            if (finished)
+            {
+                m_directions[i] = 0;
+                m_running[n] = m_running.back();
+                m_running.pop_back();
+            }
+            else
+            {
+                ++n;
+            }
+
+            dirty[m_decorations[i]] += m_apply[i](m_values[i]);
+        }
+
+        // One pass of updates per decoration for the whole frame
+        for (auto it = dirty.constBegin(); it != dirty.constEnd(); ++it)
+        {
+            for (const QRect &rect : it.value())
+                it.key()->update(rect);
+        }
+
+        if (m_running.empty())
+            m_timer.stop();
+    }
+}
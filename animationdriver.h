@@ -0,0 +1,125 @@
+#ifndef ANIMATION_DRIVER_H
+#define ANIMATION_DRIVER_H
+
+/*
+ * Copyright 2020  Alejandro Romero Rivera <k1r0d3v@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QElapsedTimer>
+#include <QRegion>
+#include <QTimer>
+
+#include <functional>
+#include <vector>
+
+namespace KDecoration2
+{
+    class Decoration;
+}
+
+
+namespace Breeze
+{
+    /**
+     * Process wide clock of the decoration and button transitions.
+     *
+     * Each transition is a value going from 0 to 1, or back, with an in-out quad easing.
+     * The running transitions are advanced together once per frame, and the areas they report
+     * are repainted with a single pass of updates per decoration.
+     */
+    class AnimationDriver
+    {
+    public:
+        /**
+         * Apply the new value of a transition.
+         * @return The area of the decoration to repaint
+         */
+        using Apply = std::function<QRegion(qreal)>;
+
+        /**
+         * @return The driver instance
+         */
+        static AnimationDriver *self();
+
+        /**
+         * Register a transition
+         *
+         * @param decoration The decoration repainted when the value changes
+         * @param apply Invoked with the new value on each frame the transition runs
+         * @param value The value it starts at, 0 or 1
+         * @return The transition handle
+         */
+        int acquire(KDecoration2::Decoration *decoration, Apply apply, qreal value = 0);
+
+        /**
+         * Forget the transition, it must be called before the decoration is destroyed
+         */
+        void release(int handle);
+
+        /**
+         * Set the time the transition takes to go from one end to the other
+         */
+        void setDuration(int handle, int duration);
+
+        /**
+         * Run the transition towards 1 when forward, else towards 0.
+         * A running transition reverses from its current value.
+         *
+         * @return False when the transition is already stopped at that end, nothing is applied then
+         */
+        bool start(int handle, bool forward);
+
+        /**
+         * @return The current eased value of the transition, 0 for an invalid handle
+         */
+        qreal value(int handle) const
+        {
+            return handle >= 0 ? m_values[static_cast<size_t>(handle)] : 0;
+        }
+
+        /**
+         * @return True while the transition moves
+         */
+        bool isRunning(int handle) const
+        {
+            return handle >= 0 && m_directions[static_cast<size_t>(handle)] != 0;
+        }
+
+    private:
+        AnimationDriver();
+
+        void tick();
+
+        // Flat per transition state, indexed by handle
+        std::vector<float> m_values; // Eased value
+        std::vector<float> m_progress; // Linear time, in range [0, 1]
+        std::vector<float> m_rates; // Progress per millisecond
+        std::vector<signed char> m_directions; // 1 forward, -1 backward, 0 stopped
+        std::vector<KDecoration2::Decoration *> m_decorations;
+        std::vector<Apply> m_apply;
+
+        std::vector<int> m_free; // Released handles
+        std::vector<int> m_running;
+
+        QElapsedTimer m_clock;
+        QTimer m_timer;
+    };
+}
+
+#endif
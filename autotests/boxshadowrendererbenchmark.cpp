@@ -0,0 +1,64 @@
+#include "breezeboxshadowrenderer.h"
+#include "shadowsizes.h"
+
+#include <QTest>
+
+using Breeze::BoxShadowRenderer;
+
+
+/**
+ * Shadow texture rendering for each decoration shadow size, with both engines
+ */
+class BoxShadowRendererBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchmarkRender_data();
+    void benchmarkRender();
+    void benchmarkRenderAnalytic_data();
+    void benchmarkRenderAnalytic();
+};
+
+void BoxShadowRendererBenchmark::benchmarkRender_data()
+{
+    ShadowSizes::addRows({ 1, 2 });
+}
+
+void BoxShadowRendererBenchmark::benchmarkRender()
+{
+    QFETCH(int, size);
+    QFETCH(qreal, devicePixelRatio);
+
+    BoxShadowRenderer renderer;
+    ShadowSizes::setUp(renderer, ShadowSizes::g_sizes[size], devicePixelRatio);
+
+    QBENCHMARK
+    {
+        renderer.render();
+    }
+}
+
+void BoxShadowRendererBenchmark::benchmarkRenderAnalytic_data()
+{
+    ShadowSizes::addRows({ 1, 2 });
+}
+
+void BoxShadowRendererBenchmark::benchmarkRenderAnalytic()
+{
+    QFETCH(int, size);
+    QFETCH(qreal, devicePixelRatio);
+
+    BoxShadowRenderer renderer;
+    ShadowSizes::setUp(renderer, ShadowSizes::g_sizes[size], devicePixelRatio);
+    renderer.setEngine(BoxShadowRenderer::Engine::Analytic);
+
+    QBENCHMARK
+    {
+        renderer.render();
+    }
+}
+
+QTEST_GUILESS_MAIN(BoxShadowRendererBenchmark)
+
+#include "boxshadowrendererbenchmark.moc"
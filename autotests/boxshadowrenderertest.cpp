@@ -0,0 +1,393 @@
+#include "breezeboxshadowrenderer.h"
+#include "shadowsizes.h"
+
+#include <QPainter>
+#include <QTest>
+#include <QtMath>
+
+#include <memory>
+
+using Breeze::BoxShadowRenderer;
+
+
+/**
+ * Checks the shadows BoxShadowRenderer renders for the decoration shadow sizes, at integer and fractional scales
+ */
+class BoxShadowRendererTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testBoxBlur_data();
+    void testBoxBlur();
+    void testBoxBlurScalar_data();
+    void testBoxBlurScalar();
+    void testAnalytic_data();
+    void testAnalytic();
+};
+
+/**
+ * The renderer as it was before the blur worked on a packed alpha plane, one alpha byte
+ * at a time with the columns read in place. The packed and vectorized blur must match it exactly.
+ */
+namespace Reference
+{
+    int calculateBlurRadius(qreal stdDev)
+    {
+        const qreal gaussianScaleFactor = (3.0 * qSqrt(2.0 * M_PI) / 4.0) * 1.5;
+        return qMax(2, qFloor(stdDev * gaussianScaleFactor + 0.5));
+    }
+
+    QSize calculateBlurExtent(int radius)
+    {
+        const int blurRadius = calculateBlurRadius(radius * 0.5);
+        return QSize(blurRadius, blurRadius);
+    }
+
+    struct BoxLobes
+    {
+        int left;
+        int right;
+    };
+
+    QVector<BoxLobes> computeLobes(int radius)
+    {
+        const int blurRadius = calculateBlurRadius(radius * 0.5);
+        const int z = blurRadius / 3;
+
+        int major = z;
+        int minor = z;
+        int final = z;
+        if (blurRadius % 3 == 1)
+        {
+            major = z + 1;
+        }
+        else if (blurRadius % 3 == 2)
+        {
+            major = z + 1;
+            final = z + 1;
+        }
+
+        return { { major, minor }, { minor, major }, { final, final } };
+    }
+
+    void boxBlurRowAlpha(const uint8_t *src, uint8_t *dst, int width, int inputStep, int outputStep, const BoxLobes &lobes)
+    {
+        const int boxSize = lobes.left + 1 + lobes.right;
+        const int reciprocal = (1 << 24) / boxSize;
+
+        uint32_t alphaSum = (boxSize + 1) / 2;
+
+        const uint8_t *left = src;
+        const uint8_t *right = src;
+        uint8_t *out = dst;
+
+        const uint8_t firstValue = src[0];
+        const uint8_t lastValue = src[(width - 1) * inputStep];
+
+        alphaSum += firstValue * lobes.left;
+
+        const uint8_t *initEnd = src + (boxSize - lobes.left) * inputStep;
+        while (right < initEnd)
+        {
+            alphaSum += *right;
+            right += inputStep;
+        }
+
+        const uint8_t *leftEnd = src + boxSize * inputStep;
+        while (right < leftEnd)
+        {
+            *out = (alphaSum * reciprocal) >> 24;
+            alphaSum += *right - firstValue;
+            right += inputStep;
+            out += outputStep;
+        }
+
+        const uint8_t *centerEnd = src + width * inputStep;
+        while (right < centerEnd)
+        {
+            *out = (alphaSum * reciprocal) >> 24;
+            alphaSum += *right - *left;
+            left += inputStep;
+            right += inputStep;
+            out += outputStep;
+        }
+
+        const uint8_t *rightEnd = dst + width * outputStep;
+        while (out < rightEnd)
+        {
+            *out = (alphaSum * reciprocal) >> 24;
+            alphaSum += lastValue - *left;
+            left += inputStep;
+            out += outputStep;
+        }
+    }
+
+    void boxBlurAlpha(QImage &image, int radius, const QRect &blurRect)
+    {
+        if (radius < 2)
+            return;
+
+        const QVector<BoxLobes> lobes = computeLobes(radius);
+
+        const int alphaOffset = QSysInfo::ByteOrder == QSysInfo::BigEndian ? 0 : 3;
+        const int width = blurRect.width();
+        const int height = blurRect.height();
+        const int rowStride = image.bytesPerLine();
+        const int pixelStride = image.depth() >> 3;
+
+        const int bufferStride = qMax(width, height) * pixelStride;
+        std::unique_ptr<uint8_t[]> buf(new uint8_t[2 * bufferStride]);
+        uint8_t *buf1 = buf.get();
+        uint8_t *buf2 = buf1 + bufferStride;
+
+        for (int i = 0; i < height; ++i)
+        {
+            uint8_t *row = image.scanLine(blurRect.y() + i) + blurRect.x() * pixelStride + alphaOffset;
+            boxBlurRowAlpha(row, buf1, width, pixelStride, pixelStride, lobes[0]);
+            boxBlurRowAlpha(buf1, buf2, width, pixelStride, pixelStride, lobes[1]);
+            boxBlurRowAlpha(buf2, row, width, pixelStride, pixelStride, lobes[2]);
+        }
+
+        for (int i = 0; i < width; ++i)
+        {
+            uint8_t *column = image.scanLine(blurRect.y()) + (blurRect.x() + i) * pixelStride + alphaOffset;
+            boxBlurRowAlpha(column, buf1, height, rowStride, pixelStride, lobes[0]);
+            boxBlurRowAlpha(buf1, buf2, height, pixelStride, pixelStride, lobes[1]);
+            boxBlurRowAlpha(buf2, column, height, pixelStride, rowStride, lobes[2]);
+        }
+    }
+
+    void mirrorTopLeftQuadrant(QImage &image)
+    {
+        const int width = image.width();
+        const int height = image.height();
+
+        const int centerX = qCeil(width * 0.5);
+        const int centerY = qCeil(height * 0.5);
+
+        const int alphaOffset = QSysInfo::ByteOrder == QSysInfo::BigEndian ? 0 : 3;
+        const int stride = image.depth() >> 3;
+
+        for (int y = 0; y < centerY; ++y)
+        {
+            uint8_t *in = image.scanLine(y) + alphaOffset;
+            uint8_t *out = in + (width - 1) * stride;
+
+            for (int x = 0; x < centerX; ++x, in += stride, out -= stride)
+                *out = *in;
+        }
+
+        for (int y = 0; y < centerY; ++y)
+        {
+            const uint8_t *in = image.scanLine(y) + alphaOffset;
+            uint8_t *out = image.scanLine(width - y - 1) + alphaOffset;
+
+            for (int x = 0; x < width; ++x, in += stride, out += stride)
+                *out = *in;
+        }
+    }
+
+    void renderShadow(QPainter *painter, const QRect &rect, qreal borderRadius, const QPoint &offset, int radius,
+                      const QColor &color)
+    {
+        const QSize size = rect.size() + 2 * calculateBlurExtent(radius);
+        const qreal dpr = painter->device()->devicePixelRatioF();
+
+        QImage shadow(size * dpr, QImage::Format_ARGB32_Premultiplied);
+        shadow.setDevicePixelRatio(dpr);
+        shadow.fill(Qt::transparent);
+
+        QRect boxRect(QPoint(0, 0), rect.size());
+        boxRect.moveCenter(QRect(QPoint(0, 0), size).center());
+
+        const qreal xRadius = 2.0 * borderRadius / boxRect.width();
+        const qreal yRadius = 2.0 * borderRadius / boxRect.height();
+
+        QPainter shadowPainter;
+        shadowPainter.begin(&shadow);
+        shadowPainter.setRenderHint(QPainter::Antialiasing);
+        shadowPainter.setPen(Qt::NoPen);
+        shadowPainter.setBrush(Qt::black);
+        shadowPainter.drawRoundedRect(boxRect, xRadius, yRadius);
+        shadowPainter.end();
+
+        const QRect blurRect(0, 0, qCeil(shadow.width() * 0.5), qCeil(shadow.height() * 0.5));
+        boxBlurAlpha(shadow, qRound(radius * dpr), blurRect);
+        mirrorTopLeftQuadrant(shadow);
+
+        shadowPainter.begin(&shadow);
+        shadowPainter.setCompositionMode(QPainter::CompositionMode_SourceIn);
+        shadowPainter.fillRect(shadow.rect(), color);
+        shadowPainter.end();
+
+        QRect shadowRect = shadow.rect();
+        shadowRect.setSize(shadowRect.size() / dpr);
+        shadowRect.moveCenter(rect.center() + offset);
+        painter->drawImage(shadowRect, shadow);
+    }
+
+    QImage render(const QSize &boxSize, const QVector<ShadowSizes::Shadow> &shadows, qreal dpr)
+    {
+        QSize canvasSize;
+        for (const auto &shadow : shadows)
+        {
+            canvasSize = canvasSize.expandedTo(
+                BoxShadowRenderer::calculateMinimumShadowTextureSize(boxSize, shadow.radius, shadow.offset));
+        }
+
+        QImage canvas(canvasSize * dpr, QImage::Format_ARGB32_Premultiplied);
+        canvas.setDevicePixelRatio(dpr);
+        canvas.fill(Qt::transparent);
+
+        QRect boxRect(QPoint(0, 0), boxSize);
+        boxRect.moveCenter(QRect(QPoint(0, 0), canvasSize).center());
+
+        QPainter painter(&canvas);
+        for (const auto &shadow : shadows)
+        {
+            renderShadow(&painter, boxRect, ShadowSizes::g_borderRadius, shadow.offset, shadow.radius,
+                         ShadowSizes::withOpacity(shadow.opacity));
+        }
+        painter.end();
+
+        return canvas;
+    }
+
+    QImage render(const ShadowSizes::Size &size, qreal dpr)
+    {
+        if (size.shadow1.radius == 0)
+            return {};
+
+        return render(ShadowSizes::boxSize(size), { size.shadow1, size.shadow2 }, dpr);
+    }
+}
+
+namespace
+{
+    // As in BoxShadowRenderer, rows and columns blurred at once, and the largest box of the vector kernel
+    const int g_blurLanes = 16;
+    const int g_maxVectorBoxSize = 256;
+}
+
+void BoxShadowRendererTest::testBoxBlur_data()
+{
+    ShadowSizes::addRows({ 1, 1.5, 2 });
+}
+
+void BoxShadowRendererTest::testBoxBlur()
+{
+    QFETCH(int, size);
+    QFETCH(qreal, devicePixelRatio);
+
+    BoxShadowRenderer renderer;
+    ShadowSizes::setUp(renderer, ShadowSizes::g_sizes[size], devicePixelRatio);
+
+    const QImage shadow = renderer.render();
+    const QImage expected = Reference::render(ShadowSizes::g_sizes[size], devicePixelRatio);
+
+    QCOMPARE(shadow.size(), expected.size());
+    QCOMPARE(shadow.devicePixelRatio(), expected.devicePixelRatio());
+    QCOMPARE(shadow, expected);
+}
+
+void BoxShadowRendererTest::testBoxBlurScalar_data()
+{
+    QTest::addColumn<QSize>("boxSize");
+    QTest::addColumn<int>("radius");
+    QTest::addColumn<qreal>("devicePixelRatio");
+
+    // Boxes wider than the vector kernel, every band is blurred by the scalar one
+    QTest::newRow("wide box @1") << QSize(64, 48) << 300 << qreal(1);
+    QTest::newRow("wide box @2") << QSize(64, 48) << 160 << qreal(2);
+
+    // Blurred areas a few lanes past a multiple of the band size, the last band of rows
+    // and of columns is blurred by the scalar kernel
+    QTest::newRow("partial bands @1") << QSize(41, 27) << 16 << qreal(1);
+    QTest::newRow("partial bands @1.5") << QSize(41, 27) << 16 << qreal(1.5);
+}
+
+void BoxShadowRendererTest::testBoxBlurScalar()
+{
+    QFETCH(QSize, boxSize);
+    QFETCH(int, radius);
+    QFETCH(qreal, devicePixelRatio);
+
+    // The row reaches the scalar kernel: a box too wide for the vector one, or a partial band
+    // on both directions of the blurred quadrant
+    int widestBox = 0;
+    for (const auto &lobes : Reference::computeLobes(qRound(radius * devicePixelRatio)))
+        widestBox = qMax(widestBox, lobes.left + 1 + lobes.right);
+
+    const QSize imageSize = (boxSize + 2 * Reference::calculateBlurExtent(radius)) * devicePixelRatio;
+    const QSize blurSize(qCeil(imageSize.width() * 0.5), qCeil(imageSize.height() * 0.5));
+    QVERIFY(widestBox > g_maxVectorBoxSize
+            || (blurSize.width() % g_blurLanes != 0 && blurSize.height() % g_blurLanes != 0));
+
+    const ShadowSizes::Shadow shadow { QPoint(0, 0), radius, 1 };
+
+    BoxShadowRenderer renderer;
+    renderer.setBorderRadius(ShadowSizes::g_borderRadius);
+    renderer.setBoxSize(boxSize);
+    renderer.setDevicePixelRatio(devicePixelRatio);
+    renderer.addShadow(shadow.offset, shadow.radius, ShadowSizes::withOpacity(shadow.opacity));
+
+    const QImage rendered = renderer.render();
+    const QImage expected = Reference::render(boxSize, { shadow }, devicePixelRatio);
+
+    QCOMPARE(rendered.size(), expected.size());
+    QCOMPARE(rendered, expected);
+}
+
+void BoxShadowRendererTest::testAnalytic_data()
+{
+    ShadowSizes::addRows({ 1, 1.5, 2 });
+}
+
+void BoxShadowRendererTest::testAnalytic()
+{
+    QFETCH(int, size);
+    QFETCH(qreal, devicePixelRatio);
+
+    BoxShadowRenderer renderer;
+    ShadowSizes::setUp(renderer, ShadowSizes::g_sizes[size], devicePixelRatio);
+    const QImage expected = renderer.render();
+
+    renderer.setEngine(BoxShadowRenderer::Engine::Analytic);
+    const QImage shadow = renderer.render();
+
+    QCOMPARE(shadow.size(), expected.size());
+    QCOMPARE(shadow.devicePixelRatio(), expected.devicePixelRatio());
+
+    // The closed form is a Gaussian, the box blur only approaches it, so the shadows
+    // are compared on the covered pixels with a tolerance
+    int maxDifference = 0;
+    qint64 totalDifference = 0;
+    int covered = 0;
+    for (int y = 0; y < shadow.height(); ++y)
+    {
+        const QRgb *line = reinterpret_cast<const QRgb *>(shadow.constScanLine(y));
+        const QRgb *expectedLine = reinterpret_cast<const QRgb *>(expected.constScanLine(y));
+        for (int x = 0; x < shadow.width(); ++x)
+        {
+            if (qAlpha(line[x]) == 0 && qAlpha(expectedLine[x]) == 0)
+                continue;
+
+            const int difference = qAbs(qAlpha(line[x]) - qAlpha(expectedLine[x]));
+            maxDifference = qMax(maxDifference, difference);
+            totalDifference += difference;
+            ++covered;
+        }
+    }
+
+    QVERIFY2(maxDifference <= 6, qPrintable(QStringLiteral("max difference %1").arg(maxDifference)));
+    if (covered > 0)
+    {
+        const qreal meanDifference = static_cast<qreal>(totalDifference) / covered;
+        QVERIFY2(meanDifference < 2, qPrintable(QStringLiteral("mean difference %1").arg(meanDifference)));
+    }
+}
+
+QTEST_GUILESS_MAIN(BoxShadowRendererTest)
+
+#include "boxshadowrenderertest.moc"
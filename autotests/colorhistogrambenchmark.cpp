@@ -0,0 +1,151 @@
+#include "colorhistogram.h"
+
+#include <QImage>
+#include <QMap>
+#include <QRandomGenerator>
+#include <QTest>
+
+
+/**
+ * Top line color lookup on the two sampled rows of a 4K wide client
+ */
+class ColorHistogramBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchmarkHistogram_data();
+    void benchmarkHistogram();
+    void benchmarkMap_data();
+    void benchmarkMap();
+
+private:
+    static void addImages();
+    static QImage image(const QString &kind);
+};
+
+namespace
+{
+    const int g_width = 3840;
+    const int g_height = 2;
+
+    /**
+     * The top line color as it was computed before ColorHistogram
+     */
+    QRgb mapMode(const QImage &image)
+    {
+        QMap<QRgb, int> histogram;
+        QRgb mode = 0;
+        int modeCount = 0;
+
+        for (int j = 0; j < image.height(); ++j)
+        {
+            for (int i = 0; i < image.width(); ++i)
+            {
+                const QRgb color = image.pixelColor(i, j).rgb();
+                const int count = histogram.contains(color) ? histogram[color] + 1 : 1;
+                histogram[color] = count;
+
+                if (count > modeCount)
+                {
+                    mode = color;
+                    modeCount = count;
+                }
+            }
+        }
+
+        return mode;
+    }
+
+    QRgb histogramMode(ColorHistogram &histogram, const QImage &image)
+    {
+        histogram.clear(image.width());
+        for (int j = 0; j < image.height(); ++j)
+            histogram.addPixels(reinterpret_cast<const QRgb *>(image.constScanLine(j)), image.width(), 0xff000000);
+
+        return histogram.mode();
+    }
+}
+
+QImage ColorHistogramBenchmark::image(const QString &kind)
+{
+    QImage image(g_width, g_height, QImage::Format_RGB32);
+
+    if (kind == QLatin1String("uniform"))
+    {
+        // A toolbar of a single color with a few widgets on it
+        image.fill(qRgb(239, 240, 241));
+        for (int i = 200; i < g_width; i += 400)
+        {
+            for (int j = 0; j < g_height; ++j)
+                image.setPixel(i, j, qRgb(61, 174, 233));
+        }
+    }
+    else if (kind == QLatin1String("gradient"))
+    {
+        for (int j = 0; j < g_height; ++j)
+        {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(j));
+            for (int i = 0; i < g_width; ++i)
+                line[i] = qRgb(i * 256 / g_width, 128, 255 - i * 256 / g_width);
+        }
+    }
+    else
+    {
+        // Worst case, almost every pixel is a different color
+        QRandomGenerator generator(42);
+        for (int j = 0; j < g_height; ++j)
+        {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(j));
+            for (int i = 0; i < g_width; ++i)
+                line[i] = generator.generate() | 0xff000000;
+        }
+    }
+
+    return image;
+}
+
+void ColorHistogramBenchmark::addImages()
+{
+    QTest::addColumn<QImage>("image");
+
+    for (const char *kind : { "uniform", "gradient", "noise" })
+        QTest::newRow(kind) << image(QLatin1String(kind));
+}
+
+void ColorHistogramBenchmark::benchmarkHistogram_data()
+{
+    addImages();
+}
+
+void ColorHistogramBenchmark::benchmarkHistogram()
+{
+    QFETCH(QImage, image);
+
+    ColorHistogram histogram;
+    QCOMPARE(histogramMode(histogram, image), mapMode(image));
+
+    QBENCHMARK
+    {
+        histogramMode(histogram, image);
+    }
+}
+
+void ColorHistogramBenchmark::benchmarkMap_data()
+{
+    addImages();
+}
+
+void ColorHistogramBenchmark::benchmarkMap()
+{
+    QFETCH(QImage, image);
+
+    QBENCHMARK
+    {
+        mapMode(image);
+    }
+}
+
+QTEST_GUILESS_MAIN(ColorHistogramBenchmark)
+
+#include "colorhistogrambenchmark.moc"
@@ -0,0 +1,206 @@
+#include "framepainter.h"
+
+#include <QPainter>
+#include <QStaticText>
+#include <QTest>
+
+using Breeze::FramePainter;
+
+
+/**
+ * Counts the pixels painted by the partial repaints of a frame and checks they leave nothing stale.
+ *
+ * The frame is painted with FramePainter, as Decoration::paint does. The caption and the button stand for
+ * the ones of the decoration, painted by the title bar contents callback only when they meet the repaint
+ * rect. The repaint regions are the ones the decoration invalidates: the button geometry for a hover, and
+ * the old and new caption rects for a caption change.
+ */
+class FramePaintRegionTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testButtonHover();
+    void testCaptionChange();
+};
+
+namespace
+{
+    // A maximized-like 4K wide frame, with the default frame radius
+    const QSize g_size(3840, 400);
+    const int g_border = 4;
+    const int g_titleBarHeight = 30;
+    const int g_radius = 3;
+
+    // Never painted by the frame, marks the untouched pixels
+    const QRgb g_sentinel = qRgba(1, 2, 3, 4);
+
+    struct Frame
+    {
+        QColor color = QColor(49, 54, 59);
+        QString caption = QStringLiteral("Konsole");
+        bool hovered = false;
+
+        QRect rect() const
+        {
+            return QRect(QPoint(0, 0), g_size);
+        }
+
+        QRect titleBarArea() const
+        {
+            return QRect(0, 0, g_size.width(), g_titleBarHeight);
+        }
+
+        QRect buttonRect() const
+        {
+            return QRect(g_size.width() - 3 * g_titleBarHeight, 3, g_titleBarHeight - 6, g_titleBarHeight - 6);
+        }
+
+        QRect captionRect() const
+        {
+            QRect rect(QPoint(0, 0), QStaticText(caption).size().toSize());
+            rect.moveCenter(titleBarArea().center());
+            return rect;
+        }
+
+        FramePainter::Frame frame() const
+        {
+            FramePainter::Frame frame;
+            frame.rect = rect();
+            frame.borders = QMargins(g_border, g_titleBarHeight, g_border, g_border);
+            frame.color = color;
+            frame.radius = g_radius;
+            frame.roundedTopLeft = true;
+            frame.roundedTopRight = true;
+            return frame;
+        }
+    };
+
+    void paintFrame(QPainter *painter, const Frame &frame, const QRect &repaintRect)
+    {
+        FramePainter::paint(painter, frame.frame(), repaintRect, [&frame](QPainter *painter, const QRect &paintRect) {
+            const QRect captionRect = frame.captionRect();
+            if (captionRect.intersects(paintRect))
+            {
+                painter->setPen(Qt::white);
+                painter->drawStaticText(captionRect.topLeft(), QStaticText(frame.caption));
+            }
+
+            if (frame.buttonRect().intersects(paintRect))
+            {
+                painter->setRenderHint(QPainter::Antialiasing);
+                painter->setPen(Qt::NoPen);
+                painter->setBrush(frame.hovered ? QColor(224, 56, 62) : QColor(98, 186, 70));
+                painter->drawEllipse(frame.buttonRect());
+            }
+        });
+    }
+
+    QImage fullPaint(const Frame &frame)
+    {
+        QImage image(g_size, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+
+        QPainter painter(&image);
+        paintFrame(&painter, frame, frame.rect());
+        return image;
+    }
+
+    /**
+     * Repaint a region of the image, cleared first as kwin does for the damaged area of a decoration
+     */
+    void repaint(QImage &image, const Frame &frame, const QRegion &region)
+    {
+        QPainter painter(&image);
+        for (const QRect &rect : region)
+        {
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            painter.fillRect(rect, Qt::transparent);
+            painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+            paintFrame(&painter, frame, rect);
+        }
+    }
+
+    /**
+     * @return The number of pixels painting the region writes
+     */
+    int paintedPixels(const Frame &frame, const QRegion &region)
+    {
+        QImage image(g_size, QImage::Format_ARGB32_Premultiplied);
+        image.fill(g_sentinel);
+
+        {
+            QPainter painter(&image);
+            for (const QRect &rect : region)
+                paintFrame(&painter, frame, rect);
+        }
+
+        int count = 0;
+        for (int y = 0; y < image.height(); ++y)
+        {
+            const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+            for (int x = 0; x < image.width(); ++x)
+                count += line[x] != g_sentinel ? 1 : 0;
+        }
+
+        return count;
+    }
+
+    int area(const QRegion &region)
+    {
+        int area = 0;
+        for (const QRect &rect : region)
+            area += rect.width() * rect.height();
+        return area;
+    }
+
+    /**
+     * Check a partial repaint of the change from previous to next matches a full repaint of next,
+     * and only writes pixels of the region
+     */
+    void checkRepaint(const Frame &previous, const Frame &next, const QRegion &region)
+    {
+        // The borders and the title bar are painted, the client area is left out
+        const QImage full = fullPaint(next);
+        QCOMPARE(full.pixel(0, g_size.height() / 2), next.color.rgba());
+        QCOMPARE(full.pixel(g_size.width() / 2, g_size.height() - 1), next.color.rgba());
+        QCOMPARE(qAlpha(full.pixel(g_size.width() / 2, 1)), 255);
+        QCOMPARE(qAlpha(full.pixel(g_size.width() / 2, g_size.height() / 2)), 0);
+
+        QImage image = fullPaint(previous);
+        repaint(image, next, region);
+        QVERIFY2(image == full, "stale pixels after the partial repaint");
+
+        const int painted = paintedPixels(next, region);
+        const int full = paintedPixels(next, QRegion(next.rect()));
+        qInfo("%d pixels painted instead of %d", painted, full);
+
+        QVERIFY(painted > 0);
+        QVERIFY(painted <= area(region));
+        QVERIFY(painted * 10 < full);
+    }
+}
+
+void FramePaintRegionTest::testButtonHover()
+{
+    const Frame previous;
+    Frame next = previous;
+    next.hovered = true;
+
+    // DecorationButton::update() dirties the button geometry
+    checkRepaint(previous, next, QRegion(next.buttonRect()));
+}
+
+void FramePaintRegionTest::testCaptionChange()
+{
+    const Frame previous;
+    Frame next = previous;
+    next.caption = QStringLiteral("~/src/breeze-enhanced : make — Konsole");
+
+    // Decoration::updateCaption() repaints the old and the new caption rects, the centered caption moves
+    checkRepaint(previous, next, QRegion(previous.captionRect() | next.captionRect()));
+}
+
+QTEST_MAIN(FramePaintRegionTest)
+
+#include "framepaintregiontest.moc"
@@ -0,0 +1,182 @@
+#include "QtX11ImageConversion.h"
+
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <QTest>
+#include <QtEndian>
+
+#include <cstring>
+
+
+/**
+ * Checks the vectorized conversion of X11 images against a per pixel reference, for every depth and byte
+ * order, at widths around the vector widths so both the vector loops and their scalar tails are run
+ */
+class QtX11ImageConversionTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testFromData_data();
+    void testFromData();
+    void testInPlace_data();
+    void testInPlace();
+
+private:
+    static void addFormats();
+};
+
+namespace
+{
+    const int g_height = 3;
+
+    // Extra bytes at the end of each line, they must never be touched
+    const int g_padding = 8;
+
+    int bytesPerPixel(int depth)
+    {
+        return depth == 16 ? 2 : 4;
+    }
+
+    QByteArray randomPixels(int bytesPerLine, int height)
+    {
+        QByteArray data(bytesPerLine * height, Qt::Uninitialized);
+        QRandomGenerator generator(static_cast<quint32>(bytesPerLine));
+        for (char &byte : data)
+            byte = static_cast<char>(generator.bounded(256));
+
+        return data;
+    }
+
+    /**
+     * @return The pixel at the given position as the native value the converted image must hold
+     */
+    quint32 referencePixel(const QByteArray &data, int bytesPerLine, int x, int y, int depth, int byteOrder)
+    {
+        const auto pixel = reinterpret_cast<const uchar *>(data.constData()) + y * bytesPerLine + x * bytesPerPixel(depth);
+
+        if (depth == 16)
+            return byteOrder == MSBFirst ? qFromBigEndian<quint16>(pixel) : qFromLittleEndian<quint16>(pixel);
+
+        const quint32 value = byteOrder == MSBFirst ? qFromBigEndian<quint32>(pixel) : qFromLittleEndian<quint32>(pixel);
+        return depth == 24 ? value | 0xff000000 : value;
+    }
+
+    quint32 imagePixel(const uchar *line, int x, int depth)
+    {
+        if (depth == 16)
+        {
+            quint16 value;
+            memcpy(&value, line + 2 * x, 2);
+            return value;
+        }
+
+        quint32 value;
+        memcpy(&value, line + 4 * x, 4);
+        return value;
+    }
+
+    void comparePixels(const uchar *bits, int imageBytesPerLine, const QByteArray &source, int bytesPerLine,
+                       int width, int depth, int byteOrder)
+    {
+        for (int y = 0; y < g_height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const quint32 actual = imagePixel(bits + y * imageBytesPerLine, x, depth);
+                const quint32 expected = referencePixel(source, bytesPerLine, x, y, depth, byteOrder);
+                if (actual != expected)
+                    QFAIL(qPrintable(QStringLiteral("pixel (%1, %2): %3 != %4").arg(x).arg(y)
+                                         .arg(actual, 0, 16).arg(expected, 0, 16)));
+            }
+        }
+    }
+}
+
+void QtX11ImageConversionTest::addFormats()
+{
+    QTest::addColumn<int>("depth");
+    QTest::addColumn<int>("byteOrder");
+    QTest::addColumn<int>("width");
+
+    // 4 and 8 pixels per vector for the 32 and 16 bit depths
+    for (int depth : { 16, 24, 32 })
+    {
+        for (int byteOrder : { LSBFirst, MSBFirst })
+        {
+            for (int width : { 1, 3, 4, 5, 7, 8, 9, 15, 17, 33 })
+            {
+                const QString name = QStringLiteral("depth %1 %2 width %3")
+                    .arg(depth).arg(byteOrder == MSBFirst ? QStringLiteral("msb") : QStringLiteral("lsb")).arg(width);
+                QTest::newRow(qPrintable(name)) << depth << byteOrder << width;
+            }
+        }
+    }
+}
+
+void QtX11ImageConversionTest::testFromData_data()
+{
+    addFormats();
+}
+
+void QtX11ImageConversionTest::testFromData()
+{
+    QFETCH(int, depth);
+    QFETCH(int, byteOrder);
+    QFETCH(int, width);
+
+    const int bytesPerLine = width * bytesPerPixel(depth) + g_padding;
+    const QByteArray source = randomPixels(bytesPerLine, g_height);
+
+    const QImage image = qimageFromXImageData(reinterpret_cast<const uchar *>(source.constData()),
+                                              width, g_height, bytesPerLine, depth, byteOrder);
+    QCOMPARE(image.size(), QSize(width, g_height));
+    QCOMPARE(image.format(), depth == 16 ? QImage::Format_RGB16
+                             : depth == 24 ? QImage::Format_RGB32 : QImage::Format_ARGB32_Premultiplied);
+
+    comparePixels(image.constBits(), image.bytesPerLine(), source, bytesPerLine, width, depth, byteOrder);
+}
+
+void QtX11ImageConversionTest::testInPlace_data()
+{
+    addFormats();
+}
+
+void QtX11ImageConversionTest::testInPlace()
+{
+    QFETCH(int, depth);
+    QFETCH(int, byteOrder);
+    QFETCH(int, width);
+
+    const int bytesPerLine = width * bytesPerPixel(depth) + g_padding;
+    const QByteArray source = randomPixels(bytesPerLine, g_height);
+    QByteArray data = source;
+
+    // Only the fields read by the conversion are set
+    XImage xi = {};
+    xi.width = width;
+    xi.height = g_height;
+    xi.depth = depth;
+    xi.bytes_per_line = bytesPerLine;
+    xi.byte_order = byteOrder;
+    xi.data = data.data();
+
+    const QImage image = qimageFromXImageInPlace(&xi);
+    QCOMPARE(image.constBits(), reinterpret_cast<const uchar *>(data.constData()));
+    QCOMPARE(image.size(), QSize(width, g_height));
+
+    comparePixels(image.constBits(), bytesPerLine, source, bytesPerLine, width, depth, byteOrder);
+    if (QTest::currentTestFailed())
+        return;
+
+    // The line padding is left as it was
+    for (int y = 0; y < g_height; ++y)
+    {
+        const int end = (y + 1) * bytesPerLine;
+        QCOMPARE(data.mid(end - g_padding, g_padding), source.mid(end - g_padding, g_padding));
+    }
+}
+
+QTEST_GUILESS_MAIN(QtX11ImageConversionTest)
+
+#include "qtx11imageconversiontest.moc"
@@ -0,0 +1,106 @@
+#ifndef SHADOW_SIZES_H
+#define SHADOW_SIZES_H
+
+/*
+ * Copyright 2020  Alejandro Romero Rivera <k1r0d3v@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "breezeboxshadowrenderer.h"
+
+#include <QTest>
+
+#include <initializer_list>
+
+
+/**
+ * The shadows of the decoration shadow size settings, as Decoration::renderShadow sets them up
+ */
+namespace ShadowSizes
+{
+    struct Shadow
+    {
+        QPoint offset;
+        int radius;
+        qreal opacity;
+    };
+
+    struct Size
+    {
+        const char *name;
+        Shadow shadow1;
+        Shadow shadow2; // Unused when the first one has no radius
+    };
+
+    const Size g_sizes[] = {
+        { "none", { QPoint(0, 0), 0, 0 }, { QPoint(0, 0), 0, 0 } },
+        { "small", { QPoint(0, 0), 16, 1 }, { QPoint(0, -2), 8, 0.4 } },
+        { "medium", { QPoint(0, 0), 32, 0.9 }, { QPoint(0, -4), 16, 0.3 } },
+        { "large", { QPoint(0, 0), 48, 0.8 }, { QPoint(0, -6), 24, 0.2 } },
+        { "very large", { QPoint(0, 0), 64, 0.7 }, { QPoint(0, -8), 32, 0.1 } },
+    };
+
+    // Default frame radius, plus the half pixel the decoration adds
+    const qreal g_borderRadius = 3.5;
+
+    inline QColor withOpacity(qreal opacity)
+    {
+        QColor color(Qt::black);
+        color.setAlphaF(opacity);
+        return color;
+    }
+
+    inline QSize boxSize(const Size &size)
+    {
+        return Breeze::BoxShadowRenderer::calculateMinimumBoxSize(size.shadow1.radius)
+            .expandedTo(Breeze::BoxShadowRenderer::calculateMinimumBoxSize(size.shadow2.radius));
+    }
+
+    inline void setUp(Breeze::BoxShadowRenderer &renderer, const Size &size, qreal devicePixelRatio)
+    {
+        renderer.setBorderRadius(g_borderRadius);
+        renderer.setBoxSize(boxSize(size));
+        renderer.setDevicePixelRatio(devicePixelRatio);
+
+        if (size.shadow1.radius == 0)
+            return;
+
+        renderer.addShadow(size.shadow1.offset, size.shadow1.radius, withOpacity(size.shadow1.opacity));
+        renderer.addShadow(size.shadow2.offset, size.shadow2.radius, withOpacity(size.shadow2.opacity));
+    }
+
+    /**
+     * Add a row per size and device pixel ratio, with the size index and the ratio as columns
+     */
+    inline void addRows(std::initializer_list<qreal> devicePixelRatios)
+    {
+        QTest::addColumn<int>("size");
+        QTest::addColumn<qreal>("devicePixelRatio");
+
+        for (qreal devicePixelRatio : devicePixelRatios)
+        {
+            for (int i = 0; i < static_cast<int>(sizeof(g_sizes) / sizeof(g_sizes[0])); ++i)
+            {
+                const QString name = QStringLiteral("%1 @%2").arg(QLatin1String(g_sizes[i].name)).arg(devicePixelRatio);
+                QTest::newRow(qPrintable(name)) << i << devicePixelRatio;
+            }
+        }
+    }
+}
+
+#endif
@@ -30,8 +30,12 @@
 #include "solidbutton.h"
 
 #include "breezeboxshadowrenderer.h"
+#include "framepainter.h"
+#include "animationdriver.h"
+#include "shadowcache.h"
 #include "util.h"
 #include "clientutil.h"
+#include "damagetracker.h"
 #include "buttonfactory.h"
 
 #include <KDecoration2/DecoratedClient>
@@ -45,7 +49,6 @@
 
 #include <QPainter>
 #include <QTimer>
-#include <QVariantAnimation>
 #include <QWindow>
 #include <QScreen>
 #include <QThread>
@@ -170,17 +173,13 @@ namespace
 namespace Breeze
 {
     static int g_decorationCount = 0;
-    static int g_shadowSizeEnum = InternalSettings::ShadowLarge;
-    static int g_shadowStrength = 255;
     static int g_titleBarColorCheckInterval = 4000;
-    static QColor g_shadowColor = Qt::black;
-    static QSharedPointer<KDecoration2::DecorationShadow> g_shadowPointer;
+    static int g_titleBarColorDamageDelay = 250;
     static QTimer g_titleBarColorTimer;
 
 
     Decoration::Decoration(QObject *parent, const QVariantList &args)
         : KDecoration2::Decoration(parent, args)
-        , m_animation(std::make_unique<QVariantAnimation>(this))
     {
         g_decorationCount++;
     }
@@ -190,11 +189,17 @@ namespace Breeze
         g_decorationCount--;
         if (g_decorationCount == 0)
         {
-            // Last decoration destroyed, clean up shadow
-            g_shadowPointer.clear();
+            // Last decoration destroyed, clean up shadows
+            ShadowCache::self()->clear();
         }
 
-        disconnect(&g_titleBarColorTimer, &QTimer::timeout, this, &Decoration::updateTitleBarColor);
+        if (m_animation != -1)
+            AnimationDriver::self()->release(m_animation);
+
+        if (m_damageTracked)
+            DamageTracker::self()->unwatch(m_clientWindow->winId());
+        else
+            disconnect(&g_titleBarColorTimer, &QTimer::timeout, this, &Decoration::updateTitleBarColor);
 
         // Delete the color scheme for this window in latte
         if (m_internalSettings->latteActivatedWindowColorNotify() || m_internalSettings->latteMaximizedWindowColorNotify())
@@ -206,14 +211,15 @@ namespace Breeze
         m_client = client().toStrongRef();
         m_settings = settings();
 
-        // Active state change animation
-        // It is important start and end value are of the same type, hence 0.0 and not just 0
-        m_animation->setStartValue(0.0);
-        m_animation->setEndValue(1.0);
-        m_animation->setEasingCurve(QEasingCurve::InOutQuad);
-        connect(m_animation.get(), &QVariantAnimation::valueChanged, this, [this](const QVariant &value) {
-            setOpacity(value.toReal());
-        });
+        // Active state change animation, the driver repaints the frame once per frame while it moves.
+        // It starts at the end matching the current state, so the first change is animated both ways.
+        // The value is quantized, the frame and title bar tiles cached for each color are reused by every transition
+        m_opacity = m_client->isActive() ? 1 : 0;
+        m_animation = AnimationDriver::self()->acquire(this, [this](qreal value) {
+            m_opacity = qRound(value * AnimationSteps) / static_cast<qreal>(AnimationSteps);
+            updateState();
+            return frameRegion();
+        }, m_opacity);
 
         reconfigure();
         updateTitleBar();
@@ -242,11 +248,15 @@ namespace Breeze
             [this]()
             {
                 // Update the caption area
-                update(titleBar());
+                updateCaption();
             }
        );
 
+        connect(m_client.data(), &KDecoration2::DecoratedClient::activeChanged, this, &Decoration::updateState);
         connect(m_client.data(), &KDecoration2::DecoratedClient::activeChanged, this, &Decoration::updateAnimationState);
+        connect(m_client.data(), &KDecoration2::DecoratedClient::iconChanged, this, &Decoration::updateStateIcon);
+        updateStateIcon();
+        updateState();
         connect(m_client.data(), &KDecoration2::DecoratedClient::widthChanged, this, &Decoration::updateTitleBar);
         connect(m_client.data(), &KDecoration2::DecoratedClient::maximizedChanged, this, &Decoration::updateTitleBar);
         //connect(c, &KDecoration2::DecoratedClient::maximizedChanged, this, &Decoration::setOpaque);
@@ -261,12 +271,29 @@ namespace Breeze
         m_clientWindow = std::unique_ptr<QWindow>(QWindow::fromWinId(m_client->windowId()));
         m_clientUtil = std::make_unique<ClientUtil>(*m_clientWindow);
 
+        m_clientUtil->setClientSize(m_client->size());
+        connect(&m_titleBarColorWatcher, &QFutureWatcher<ClientUtil::ColorSample>::finished, this, &Decoration::applyTitleBarColor);
+        connect(m_client.data(), &KDecoration2::DecoratedClient::sizeChanged, this, [this]() {
+            m_clientUtil->setClientSize(m_client->size());
+        });
+
         // m_internalSettings is available only after reconfigure() call
         m_hideTitleBar = m_internalSettings->hideTitleBar();
 
-        if (!g_titleBarColorTimer.isActive())
-            g_titleBarColorTimer.start(g_titleBarColorCheckInterval);
-        connect(&g_titleBarColorTimer, &QTimer::timeout, this, &Decoration::updateTitleBarColor);
+        // Sample the title bar color only when the client repaints its top rows,
+        // fallback to polling when the damage extension is not available
+        m_damageTracked = DamageTracker::self()->watch(m_clientWindow->winId(), ClientUtil::TopLineRows,
+                                                       [this]() { updateTitleBarColorDelayed(); });
+        if (m_damageTracked)
+        {
+            connect(m_client.data(), &KDecoration2::DecoratedClient::activeChanged, this, &Decoration::updateTitleBarColorDelayed);
+        }
+        else
+        {
+            if (!g_titleBarColorTimer.isActive())
+                g_titleBarColorTimer.start(g_titleBarColorCheckInterval);
+            connect(&g_titleBarColorTimer, &QTimer::timeout, this, &Decoration::updateTitleBarColor);
+        }
 
         createButtons();
         createShadow();
@@ -278,15 +305,6 @@ namespace Breeze
         QTimer::singleShot(500, this, &Decoration::updateTitleBarColor);
     }
 
-    void Decoration::setOpacity(qreal value)
-    {
-        if (m_opacity == value)
-            return;
-
-        m_opacity = value;
-        update();
-    }
-
     QColor Decoration::getTitleBarColor() const
     {
         auto active = m_client->color(KDecoration2::ColorGroup::Active, KDecoration2::ColorRole::TitleBar);
@@ -300,7 +318,7 @@ namespace Breeze
 
         if (hideTitleBar())
             return inactive;
-        else if(m_animation->state() == QAbstractAnimation::Running)
+        else if(AnimationDriver::self()->isRunning(m_animation))
             return KColorUtils::mix(inactive, active, m_opacity);
         else
             return m_client->isActive() ? active : inactive;
@@ -318,7 +336,7 @@ namespace Breeze
             inactive = inactiveGrayFrom(m_titleBarColor);
         }
 
-        if(m_animation->state() == QAbstractAnimation::Running)
+        if(AnimationDriver::self()->isRunning(m_animation))
             return KColorUtils::mix(inactive, active, m_opacity);
         else
             return  m_client->isActive() ? active : inactive;
@@ -361,7 +379,31 @@ namespace Breeze
         if (m_clientUtil == nullptr || !m_client->isActive())
             return;
 
-        auto color =  m_clientUtil->topLineColor();
+        // The color is applied from applyTitleBarColor once the capture is done,
+        // a few probe points are enough to tell when the color did not change
+        m_titleBarColorStrategy = ClientUtil::SamplingStrategy::Probe;
+        m_titleBarColorWatcher.setFuture(m_clientUtil->requestTopLineColor(m_titleBarColorStrategy));
+    }
+
+    void Decoration::applyTitleBarColor()
+    {
+        const auto future = m_titleBarColorWatcher.future();
+        if (future.resultCount() == 0)
+            return;
+
+        const auto sample = future.result();
+
+        // Scan the whole top line only when the probe does not agree with the current color. The scan is
+        // requested asynchronously as the probe was, the current color is kept until its reply
+        if (m_titleBarColorStrategy == ClientUtil::SamplingStrategy::Probe
+            && (sample.confidence < 1 || sample.color != m_titleBarColor))
+        {
+            m_titleBarColorStrategy = ClientUtil::SamplingStrategy::Full;
+            m_titleBarColorWatcher.setFuture(m_clientUtil->requestTopLineColor(m_titleBarColorStrategy));
+            return;
+        }
+
+        auto color = sample.color;
         if (color.isValid())
         {
             if (!m_titleBarColor.isValid() || (m_titleBarColor.isValid() && m_titleBarColor != color))
@@ -369,20 +411,31 @@ namespace Breeze
                 m_titleBarColor = color;
                 if (m_internalSettings->latteActivatedWindowColorNotify() || (m_internalSettings->latteMaximizedWindowColorNotify() && isMaximized()))
                     sendColorToLatteDock(m_clientWindow->winId(), m_titleBarColor);
-                update();
+                updateState();
+                updateFrame();
             }
         }
     }
 
+    void Decoration::updateTitleBarColorDelayed()
+    {
+        // Coalesce damage bursts into a single sample
+        if (m_titleBarColorPending)
+            return;
+
+        m_titleBarColorPending = true;
+        QTimer::singleShot(g_titleBarColorDamageDelay, this, [this]() {
+            m_titleBarColorPending = false;
+            updateTitleBarColor();
+        });
+    }
+
     void Decoration::updateAnimationState()
     {
-        if(m_internalSettings->animationsEnabled())
-        {
-            m_animation->setDirection(m_client->isActive() ? QAbstractAnimation::Forward : QAbstractAnimation::Backward);
-            if(m_animation->state() != QAbstractAnimation::Running)
-                m_animation->start();
-        }
-        else update();
+        // Repaint at once when there is nothing to animate, e.g. the transition was left at the
+        // other end while the animations were disabled
+        if(!m_internalSettings->animationsEnabled() || !AnimationDriver::self()->start(m_animation, m_client->isActive()))
+            updateFrame();
     }
 
     int Decoration::getBorderSize(bool bottom) const
@@ -426,9 +479,10 @@ namespace Breeze
     void Decoration::reconfigure()
     {
         m_internalSettings = SettingsProvider::self()->internalSettings(this);
+        invalidateCaptionLayout();
 
         // Animation
-        m_animation->setDuration(m_internalSettings->animationsDuration());
+        AnimationDriver::self()->setDuration(m_animation, m_internalSettings->animationsDuration());
 
         // Borders
         recalculateBorders();
@@ -451,9 +505,8 @@ namespace Breeze
         }
         else
         {
-            QFont f; f.fromString(m_internalSettings->titleBarFont());
-            QFontMetrics fm(f);
-            top += qMax(fm.height(), getButtonHeight());
+            const auto font = SettingsProvider::self()->titleBarFont(m_internalSettings);
+            top += qMax(font->metrics.height(), getButtonHeight());
 
             // Padding below
             // Extra pixel is used for the active window outline
@@ -500,6 +553,9 @@ namespace Breeze
 
     void Decoration::updateButtonsGeometry()
     {
+        // The caption is laid out between the buttons
+        invalidateCaptionLayout();
+
         // Adjust button position
         const int buttonHeight =
                 this->getCaptionHeight() + (isTopEdge() ? m_settings->smallSpacing() * Metrics::TitleBar_TopMargin : 0);
@@ -556,133 +612,79 @@ namespace Breeze
                 m_rightButtons->setPos(QPointF(size().width() - m_rightButtons->geometry().width() - hPadding - borderRight(), vPadding));
         }
 
-        update();
+        // Buttons and caption never leave the title bar
+        updateTitleBarArea();
     }
 
     void Decoration::paint(QPainter *painter, const QRect &repaintRegion)
     {
-        // TODO: optimize based on repaintRegion
-        auto &c = m_client;
-        auto &s = m_settings;
-
-        // Paint background of borders
-        if(!c->isShaded())
-        {
-            painter->fillRect(rect(), Qt::transparent);
-            painter->save();
-            painter->setRenderHint(QPainter::Antialiasing);
-            painter->setPen(Qt::NoPen);
-
-            QColor winCol = this->getTitleBarColor();
-            winCol.setAlpha(getTitleBarAlpha());
-            painter->setBrush(winCol);
-
-            // clip away the top part
-            if(!hideTitleBar())
-                painter->setClipRect(0, borderTop(), size().width(), size().height() - borderTop(), Qt::IntersectClip);
-
-            if(s->isAlphaChannelSupported())
-                painter->drawRoundedRect(rect(), (internalSettings()->frameRadius()), (internalSettings()->frameRadius()));
-            else
-                painter->drawRect(rect());
-
-            painter->restore();
-        }
+        const QRect paintRect = repaintRegion & rect();
+        if (paintRect.isEmpty())
+            return;
 
-        // Paint title bar
-        if(!hideTitleBar())
-            paintTitleBar(painter, repaintRegion);
+        // Buttons read the state of this frame instead of querying the client each time they paint
+        updateState();
 
-        // Paint borders when no aplha is supported
-        if(!hasNoBorders() && !s->isAlphaChannelSupported())
+        // The shadow follows the scale kwin paints the decoration at, e.g. after moving to another screen.
+        // It is not replaced in the middle of a paint, already rendered scales are reused from the cache
+        const qreal devicePixelRatio = painter->device()->devicePixelRatioF();
+        if (devicePixelRatio != m_devicePixelRatio)
         {
-            painter->save();
-            painter->setRenderHint(QPainter::Antialiasing, false);
-            painter->setBrush(Qt::NoBrush);
-            painter->setPen(c->isActive() ?
-                c->color(KDecoration2::ColorGroup::Active, KDecoration2::ColorRole::TitleBar):
-                c->color(KDecoration2::ColorGroup::Inactive, KDecoration2::ColorRole::Foreground));
-
-            painter->drawRect(rect().adjusted(0, 0, -1, -1));
-            painter->restore();
+            const qreal shadowDevicePixelRatio = this->shadowDevicePixelRatio();
+            m_devicePixelRatio = devicePixelRatio;
+            if (this->shadowDevicePixelRatio() != shadowDevicePixelRatio)
+                QTimer::singleShot(0, this, &Decoration::createShadow);
         }
+
+        FramePainter::paint(painter, frame(), paintRect, [this](QPainter *painter, const QRect &paintRect) {
+            paintTitleBarContents(painter, paintRect);
+        });
     }
 
-    void Decoration::paintTitleBar(QPainter *painter, const QRect &repaintRegion)
+    FramePainter::Frame Decoration::frame() const
     {
-        const auto &c = m_client;
-        const QRect titleRect(QPoint(0, 0), QSize(size().width(), borderTop()));
-
-        if (!titleRect.intersects(repaintRegion))
-            return;
+        const bool alpha = m_settings->isAlphaChannelSupported();
 
-        painter->save();
-        painter->setPen(Qt::NoPen);
+        FramePainter::Frame frame;
+        frame.rect = rect();
+        frame.borders = QMargins(borderLeft(), borderTop(), borderRight(), borderBottom());
 
-        // render a linear gradient on title area and draw a light border at the top
-        if(m_internalSettings->drawBackgroundGradient() && !m_internalSettings->flatTitleBar())
-        {
-            QColor titleBarColor(this->getTitleBarColor());
-            titleBarColor.setAlpha(getTitleBarAlpha());
-
-            QLinearGradient gradient(0, 0, 0, titleRect.height());
-            QColor lightCol(titleBarColor.lighter(130 + m_internalSettings->backgroundGradientIntensity()));
-            gradient.setColorAt(0.0, lightCol);
-            gradient.setColorAt(0.99 / static_cast<qreal>(titleRect.height()), lightCol);
-            gradient.setColorAt(1.0 / static_cast<qreal>(titleRect.height()), titleBarColor.lighter(100 + m_internalSettings->backgroundGradientIntensity()));
-            gradient.setColorAt(1.0, titleBarColor);
-
-            painter->setBrush(gradient);
+        frame.color = getTitleBarColor();
+        frame.color.setAlpha(getTitleBarAlpha());
+        frame.radius = alpha ? m_internalSettings->frameRadius() : 0;
 
-        } else {
+        const bool gradient = m_internalSettings->drawBackgroundGradient() && !m_internalSettings->flatTitleBar();
+        frame.intensity = gradient ? m_internalSettings->backgroundGradientIntensity() : 0;
 
-            QColor titleBarColor = this->getTitleBarColor();
-            titleBarColor.setAlpha(getTitleBarAlpha());
+        frame.shaded = m_client->isShaded();
+        frame.titleBarHidden = hideTitleBar();
 
-            QLinearGradient gradient(0, 0, 0, titleRect.height());
-            QColor lightCol(titleBarColor.lighter(130));
-            gradient.setColorAt(0.0, lightCol);
-            gradient.setColorAt(0.99 / static_cast<qreal>(titleRect.height()), lightCol);
-            gradient.setColorAt(1.0 / static_cast<qreal>(titleRect.height()), titleBarColor);
-            gradient.setColorAt(1.0, titleBarColor);
-
-            painter->setBrush(gradient);
-
-        }
+        // the corners are square on the screen edges
+        const bool rounded = !isMaximized() && !isTopEdge();
+        frame.roundedTitleBar = frame.shaded && !isMaximized();
+        frame.roundedTopLeft = rounded && !isLeftEdge();
+        frame.roundedTopRight = rounded && !isRightEdge();
 
-        auto &s = m_settings;
-        if(isMaximized() || !s->isAlphaChannelSupported())
+        if (!hasNoBorders() && !alpha)
         {
-            painter->drawRect(titleRect);
-        }
-        else if(c->isShaded())
-        {
-            painter->drawRoundedRect(titleRect, (internalSettings()->frameRadius()), (internalSettings()->frameRadius()));
-        }
-        else
-        {
-            painter->setClipRect(titleRect, Qt::IntersectClip);
-
-            // the rect is made a little bit larger to be able to clip away the rounded corners at the bottom and sides
-            painter->drawRoundedRect(titleRect.adjusted(
-                isLeftEdge() ? -(internalSettings()->frameRadius()):0,
-                isTopEdge() ? -(internalSettings()->frameRadius()):0,
-                isRightEdge() ? (internalSettings()->frameRadius()):0,
-                (internalSettings()->frameRadius())),
-                (internalSettings()->frameRadius()), (internalSettings()->frameRadius()));
+            frame.outline = m_client->isActive() ?
+                m_client->color(KDecoration2::ColorGroup::Active, KDecoration2::ColorRole::TitleBar):
+                m_client->color(KDecoration2::ColorGroup::Inactive, KDecoration2::ColorRole::Foreground);
         }
 
-        painter->restore();
+        return frame;
+    }
 
+    void Decoration::paintTitleBarContents(QPainter *painter, const QRect &repaintRegion)
+    {
         // draw caption
-        QFont f; f.fromString(m_internalSettings->titleBarFont());
-        // KDE needs this FIXME: Why?
-        QFontDatabase fd; f.setStyleName(fd.styleString(f));
-        painter->setFont(f);
-        painter->setPen(getFontColor());
-        const auto cR = captionRect();
-        const QString caption = painter->fontMetrics().elidedText(c->caption(), Qt::ElideMiddle, cR.first.width());
-        painter->drawText(cR.first, static_cast<int>(cR.second | Qt::TextSingleLine), caption);
+        const auto &caption = captionLayout();
+        if (caption.rect.intersects(repaintRegion))
+        {
+            painter->setFont(caption.font->font);
+            painter->setPen(getFontColor());
+            painter->drawStaticText(caption.position, caption.text);
+        }
 
         // draw all buttons
         m_leftButtons->paint(painter, repaintRegion);
@@ -708,6 +710,83 @@ namespace Breeze
         return hideTitleBar() ? borderTop() : borderTop() - m_settings->smallSpacing() * (Metrics::TitleBar_BottomMargin + Metrics::TitleBar_TopMargin) - 1;
     }
 
+    void Decoration::updateState()
+    {
+        m_state.isActive = m_client->isActive();
+        m_state.titleBarColor = getTitleBarColor();
+    }
+
+    void Decoration::updateStateIcon()
+    {
+        m_state.icon = m_client->icon();
+        m_state.iconCacheKey = m_state.icon.cacheKey();
+    }
+
+    void Decoration::updateCaption()
+    {
+        const QRect previous = m_captionLayout.valid ? m_captionLayout.rect : QRect();
+        invalidateCaptionLayout();
+
+        if (hideTitleBar())
+            return;
+
+        // The centered caption may move when its width changes, repaint both places
+        update(previous | captionLayout().rect);
+    }
+
+    QRegion Decoration::bordersRegion() const
+    {
+        const int top = hideTitleBar() ? 0 : borderTop();
+        const int height = size().height() - top;
+
+        QRegion region;
+        if (borderLeft() > 0)
+            region += QRect(0, top, borderLeft(), height);
+        if (borderRight() > 0)
+            region += QRect(size().width() - borderRight(), top, borderRight(), height);
+        if (borderBottom() > 0)
+            region += QRect(0, size().height() - borderBottom(), size().width(), borderBottom());
+        if (top == 0 && borderTop() > 0)
+            region += QRect(0, 0, size().width(), borderTop());
+        return region;
+    }
+
+    const Decoration::CaptionLayout &Decoration::captionLayout()
+    {
+        const auto font = SettingsProvider::self()->titleBarFont(m_internalSettings);
+        const int alignment = m_internalSettings->titleAlignment();
+
+        if (m_captionLayout.valid && m_captionLayout.font == font && m_captionLayout.width == size().width()
+            && m_captionLayout.alignment == alignment)
+            return m_captionLayout;
+
+        const auto cR = captionRect();
+        const QString caption = font->metrics.elidedText(m_client->caption(), Qt::ElideMiddle, cR.first.width());
+
+        m_captionLayout.valid = true;
+        m_captionLayout.font = font;
+        m_captionLayout.width = size().width();
+        m_captionLayout.alignment = alignment;
+        m_captionLayout.rect = cR.first;
+
+        // Shape the text once, repaints only draw the prepared glyphs
+        m_captionLayout.text = QStaticText(caption);
+        m_captionLayout.text.setTextFormat(Qt::PlainText);
+        m_captionLayout.text.prepare(QTransform(), font->font);
+
+        // Same placement drawText does with the caption rect alignment
+        const QSize textSize = m_captionLayout.text.size().toSize();
+        int x = cR.first.left();
+        if (cR.second & Qt::AlignRight)
+            x = cR.first.right() + 1 - textSize.width();
+        else if (cR.second & Qt::AlignHCenter)
+            x = cR.first.left() + (cR.first.width() - textSize.width()) / 2;
+        const int y = cR.first.top() + (cR.first.height() - textSize.height()) / 2;
+        m_captionLayout.position = QPoint(x, y);
+
+        return m_captionLayout;
+    }
+
     QPair<QRect,Qt::Alignment> Decoration::captionRect() const
     {
         if(hideTitleBar()) return qMakePair(QRect(), Qt::AlignCenter);
@@ -743,9 +822,8 @@ namespace Breeze
 
                     // full caption rect
                     const QRect fullRect = QRect(0, yOffset, size().width(), getCaptionHeight());
-                    QFont f; f.fromString(m_internalSettings->titleBarFont());
-                    QFontMetrics fm(f);
-                    QRect boundingRect(fm.boundingRect(c->caption()));
+                    const auto font = SettingsProvider::self()->titleBarFont(m_internalSettings);
+                    QRect boundingRect(font->metrics.boundingRect(c->caption()));
 
                     // text bounding rect
                     boundingRect.setTop(yOffset);
@@ -766,86 +844,95 @@ namespace Breeze
 
     void Decoration::createShadow()
     {
-        if (!g_shadowPointer
-                ||g_shadowSizeEnum != m_internalSettings->shadowSize()
-                || g_shadowStrength != m_internalSettings->shadowStrength()
-                || g_shadowColor != m_internalSettings->shadowColor())
-        {
-            g_shadowSizeEnum = m_internalSettings->shadowSize();
-            g_shadowStrength = m_internalSettings->shadowStrength();
-            g_shadowColor = m_internalSettings->shadowColor();
-
-            const CompositeShadowParams params = lookupShadowParams(g_shadowSizeEnum);
-            if (params.isNone()) {
-                g_shadowPointer.clear();
-                setShadow(g_shadowPointer);
-                return;
-            }
+        const ShadowCache::Key key {
+            m_internalSettings->shadowSize(), m_internalSettings->shadowStrength(),
+            m_internalSettings->shadowColor().rgba(), internalSettings()->frameRadius(), shadowDevicePixelRatio()
+        };
 
-            auto withOpacity = [](const QColor &color, qreal opacity) -> QColor {
-                QColor c(color);
-                c.setAlphaF(opacity);
-                return c;
-            };
-
-            const QSize boxSize = BoxShadowRenderer::calculateMinimumBoxSize(params.shadow1.radius)
-                .expandedTo(BoxShadowRenderer::calculateMinimumBoxSize(params.shadow2.radius));
-
-            BoxShadowRenderer shadowRenderer;
-            shadowRenderer.setBorderRadius((internalSettings()->frameRadius()) + 0.5);
-            shadowRenderer.setBoxSize(boxSize);
-            shadowRenderer.setDevicePixelRatio(1.0); // TODO: Create HiDPI shadows?
-
-            const qreal strength = static_cast<qreal>(g_shadowStrength) / 255.0;
-            shadowRenderer.addShadow(params.shadow1.offset, params.shadow1.radius,
-                withOpacity(g_shadowColor, params.shadow1.opacity * strength));
-            shadowRenderer.addShadow(params.shadow2.offset, params.shadow2.radius,
-                withOpacity(g_shadowColor, params.shadow2.opacity * strength));
-
-            QImage shadowTexture = shadowRenderer.render();
-
-            QPainter painter(&shadowTexture);
-            painter.setRenderHint(QPainter::Antialiasing);
-
-            const QRect outerRect = shadowTexture.rect();
-
-            QRect boxRect(QPoint(0, 0), boxSize);
-            boxRect.moveCenter(outerRect.center());
-
-            // Mask out inner rect.
-            const QMargins padding = QMargins(
-                boxRect.left() - outerRect.left() - Metrics::Shadow_Overlap - params.offset.x(),
-                boxRect.top() - outerRect.top() - Metrics::Shadow_Overlap - params.offset.y(),
-                outerRect.right() - boxRect.right() - Metrics::Shadow_Overlap + params.offset.x(),
-                outerRect.bottom() - boxRect.bottom() - Metrics::Shadow_Overlap + params.offset.y());
-            const QRect innerRect = outerRect - padding;
-
-            painter.setPen(Qt::NoPen);
-            painter.setBrush(Qt::black);
-            painter.setCompositionMode(QPainter::CompositionMode_DestinationOut);
-            painter.drawRoundedRect(
-                innerRect,
-                (internalSettings()->frameRadius()) + 0.5,
-                (internalSettings()->frameRadius()) + 0.5);
-
-            // Draw outline.
-            painter.setPen(withOpacity(g_shadowColor, 0.2 * strength));
-            painter.setBrush(Qt::NoBrush);
-            painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-            painter.drawRoundedRect(
-                innerRect,
-                (internalSettings()->frameRadius()) - 0.5,
-                (internalSettings()->frameRadius()) - 0.5);
-
-            painter.end();
-
-            g_shadowPointer = QSharedPointer<KDecoration2::DecorationShadow>::create();
-            g_shadowPointer->setPadding(padding);
-            g_shadowPointer->setInnerShadowRect(QRect(outerRect.center(), QSize(1, 1)));
-            g_shadowPointer->setShadow(shadowTexture);
+        ShadowCache::ShadowPtr shadow;
+        if (!ShadowCache::self()->lookup(key, shadow))
+        {
+            shadow = renderShadow(key);
+            ShadowCache::self()->insert(key, shadow);
         }
 
-        setShadow(g_shadowPointer);
+        setShadow(shadow);
+    }
+
+    qreal Decoration::shadowDevicePixelRatio() const
+    {
+#if BREEZE_SCALED_SHADOWS
+        return m_devicePixelRatio;
+#else
+        return 1.0;
+#endif
+    }
+
+    ShadowCache::ShadowPtr Decoration::renderShadow(const ShadowCache::Key &key) const
+    {
+        const CompositeShadowParams params = lookupShadowParams(key.size);
+        if (params.isNone())
+            return {};
+
+        auto withOpacity = [](const QColor &color, qreal opacity) -> QColor {
+            QColor c(color);
+            c.setAlphaF(opacity);
+            return c;
+        };
+
+        const QColor shadowColor = QColor::fromRgba(key.color);
+        const QSize boxSize = BoxShadowRenderer::calculateMinimumBoxSize(params.shadow1.radius)
+            .expandedTo(BoxShadowRenderer::calculateMinimumBoxSize(params.shadow2.radius));
+
+        BoxShadowRenderer shadowRenderer;
+        shadowRenderer.setBorderRadius(key.frameRadius + 0.5);
+        shadowRenderer.setBoxSize(boxSize);
+        shadowRenderer.setDevicePixelRatio(key.devicePixelRatio);
+
+        const qreal strength = static_cast<qreal>(key.strength) / 255.0;
+        shadowRenderer.addShadow(params.shadow1.offset, params.shadow1.radius,
+            withOpacity(shadowColor, params.shadow1.opacity * strength));
+        shadowRenderer.addShadow(params.shadow2.offset, params.shadow2.radius,
+            withOpacity(shadowColor, params.shadow2.opacity * strength));
+
+        QImage shadowTexture = shadowRenderer.render();
+
+        QPainter painter(&shadowTexture);
+        painter.setRenderHint(QPainter::Antialiasing);
+
+        // The texture is rendered at the shadow scale, the painter and the padding work in logical pixels
+        const QRect outerRect(QPoint(0, 0), shadowTexture.size() / key.devicePixelRatio);
+
+        QRect boxRect(QPoint(0, 0), boxSize);
+        boxRect.moveCenter(outerRect.center());
+
+        // Mask out inner rect.
+        const QMargins padding = QMargins(
+            boxRect.left() - outerRect.left() - Metrics::Shadow_Overlap - params.offset.x(),
+            boxRect.top() - outerRect.top() - Metrics::Shadow_Overlap - params.offset.y(),
+            outerRect.right() - boxRect.right() - Metrics::Shadow_Overlap + params.offset.x(),
+            outerRect.bottom() - boxRect.bottom() - Metrics::Shadow_Overlap + params.offset.y());
+        const QRect innerRect = outerRect - padding;
+
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(Qt::black);
+        painter.setCompositionMode(QPainter::CompositionMode_DestinationOut);
+        painter.drawRoundedRect(innerRect, key.frameRadius + 0.5, key.frameRadius + 0.5);
+
+        // Draw outline.
+        painter.setPen(withOpacity(shadowColor, 0.2 * strength));
+        painter.setBrush(Qt::NoBrush);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        painter.drawRoundedRect(innerRect, key.frameRadius - 0.5, key.frameRadius - 0.5);
+
+        painter.end();
+
+        auto shadow = ShadowCache::ShadowPtr::create();
+        shadow->setPadding(padding);
+        // The shadow elements are sliced from the texture pixels, see BREEZE_SCALED_SHADOWS for their scale
+        shadow->setInnerShadowRect(QRect(shadowTexture.rect().center(), QSize(1, 1)));
+        shadow->setShadow(shadowTexture);
+        return shadow;
     }
 } // namespace
 
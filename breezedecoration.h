@@ -26,23 +26,38 @@
 #include "breeze.h"
 #include "breezesettings.h"
 #include "clientutil.h"
+#include "framepainter.h"
+#include "shadowcache.h"
 
 #include <KDecoration2/Decoration>
 #include <KDecoration2/DecoratedClient>
 #include <KDecoration2/DecorationSettings>
 #include <KDecoration2/DecorationButtonGroup>
 
+#include <QIcon>
+#include <QRegion>
 #include <QWindow>
-#include <QVariantAnimation>
+#include <QStaticText>
+#include <QFutureWatcher>
 
 
 
 namespace Breeze
 {
+    class TitleBarFont;
+
     class Decoration : public KDecoration2::Decoration
     {
         Q_OBJECT
     public:
+        // Decoration state read by the buttons, refreshed once per paint and on state changes
+        struct State
+        {
+            bool isActive = false;
+            QColor titleBarColor = {};
+            QIcon icon = {};
+            qint64 iconCacheKey = 0;
+        };
 
         /**
          * Constructor
@@ -77,11 +92,6 @@ namespace Breeze
          */
         int getButtonHeight() const;
 
-        /**
-         * Active state change animation
-         */
-        void setOpacity(qreal);
-
         /**
          * @return The decoration opacity
          */
@@ -95,6 +105,14 @@ namespace Breeze
          */
         QColor getTitleBarColor() const;
 
+        /**
+         * @return The current state snapshot, valid until the next state change
+         */
+        const State &state() const
+        {
+            return m_state;
+        }
+
         /**
          * @return The font color
          */
@@ -165,17 +183,120 @@ namespace Breeze
         void updateTitleBar();
         void updateAnimationState();
         void updateTitleBarColor();
+        void updateTitleBarColorDelayed();
+        void applyTitleBarColor();
         void clientMaximizedChanged(bool maximized);
 
     private:
+        // Caption laid out for painting
+        struct CaptionLayout
+        {
+            bool valid = false;
+            QSharedPointer<const TitleBarFont> font;
+            int width = 0;
+            int alignment = 0;
+            QRect rect;
+            QStaticText text;
+            QPoint position;
+        };
+
         QPair<QRect,Qt::Alignment> captionRect() const;
 
+        /**
+         * @return The caption layout, rebuilt only when the caption, the font,
+         * the decoration width or the title alignment changed since the last call
+         */
+        const CaptionLayout &captionLayout();
+
+        /**
+         * Refresh the state snapshot read by the buttons
+         */
+        void updateState();
+
+        /**
+         * Copy the client icon into the state snapshot, done only when it changes
+         */
+        void updateStateIcon();
+
+        void invalidateCaptionLayout()
+        {
+            m_captionLayout.valid = false;
+        }
+
+        /**
+         * Repaint only the area of the caption, before and after it changed
+         */
+        void updateCaption();
+
+        /**
+         * @return The title bar area, with its buttons and caption
+         */
+        QRect titleBarArea() const
+        {
+            return QRect(0, 0, size().width(), borderTop());
+        }
+
+        /**
+         * @return The border strips around the client
+         */
+        QRegion bordersRegion() const;
+
+        /**
+         * @return Everything painted with the title bar color, the client area is left out
+         */
+        QRegion frameRegion() const
+        {
+            return bordersRegion() + titleBarArea();
+        }
+
+        void updateRegion(const QRegion &region)
+        {
+            for (const QRect &rect : region)
+                update(rect);
+        }
+
+        /**
+         * Repaint only the title bar area
+         */
+        void updateTitleBarArea()
+        {
+            update(titleBarArea());
+        }
+
+        /**
+         * Repaint everything painted with the title bar color, the client area is left out
+         */
+        void updateFrame()
+        {
+            updateRegion(frameRegion());
+        }
+
         void createButtons();
 
-        void paintTitleBar(QPainter *painter, const QRect &repaintRegion);
+        /**
+         * @return The frame as FramePainter paints it
+         */
+        FramePainter::Frame frame() const;
+
+        /**
+         * Paint the caption and the buttons that meet the repaint region
+         */
+        void paintTitleBarContents(QPainter *painter, const QRect &repaintRegion);
 
         void createShadow();
 
+        /**
+         * @return The device pixel ratio the shadow is rendered at, the one of the last paint
+         * when built with BREEZE_SCALED_SHADOWS, else 1. KWin 5 shows a shadow texture at its
+         * size in pixels, so scaled shadows are disabled by default
+         */
+        qreal shadowDevicePixelRatio() const;
+
+        /**
+         * Render the shadow described by the key, a null shadow when the size has none
+         */
+        ShadowCache::ShadowPtr renderShadow(const ShadowCache::Key &key) const;
+
         int getBorderSize(bool bottom = false) const;
 
         bool hasNoBorders() const
@@ -206,18 +327,28 @@ namespace Breeze
         }
 
     private:
+        // Steps of the active state change opacity
+        static constexpr int AnimationSteps = 32;
+
         QSharedPointer<InternalSettings> m_internalSettings = nullptr;
         QSharedPointer<KDecoration2::DecoratedClient> m_client = nullptr;
         QSharedPointer<KDecoration2::DecorationSettings> m_settings = nullptr;
         std::unique_ptr<KDecoration2::DecorationButtonGroup> m_leftButtons = nullptr;
         std::unique_ptr<KDecoration2::DecorationButtonGroup> m_rightButtons = nullptr;
-        std::unique_ptr<QVariantAnimation> m_animation = nullptr; // Active state change animation
+        int m_animation = -1; // Active state change transition handle, see AnimationDriver
         std::unique_ptr<QWindow> m_clientWindow = nullptr;
         std::unique_ptr<ClientUtil> m_clientUtil = nullptr;
+        QFutureWatcher<ClientUtil::ColorSample> m_titleBarColorWatcher;
+        ClientUtil::SamplingStrategy m_titleBarColorStrategy = ClientUtil::SamplingStrategy::Probe; // Of the watched request
+        CaptionLayout m_captionLayout;
+        State m_state;
 
         QColor m_titleBarColor = {};
         qreal m_opacity = 0; // Active state change opacity
+        qreal m_devicePixelRatio = 1; // Device pixel ratio of the last paint
         bool m_hideTitleBar = false;
+        bool m_damageTracked = false; // Title bar color sampled on client damage instead of polling
+        bool m_titleBarColorPending = false;
     };
 }
 
@@ -24,6 +24,7 @@
 
 #include <KWindowInfo>
 
+#include <QFontDatabase>
 #include <QTextStream>
 
 namespace Breeze
@@ -65,6 +66,30 @@ namespace Breeze
         exceptions.readConfig( m_config );
         m_exceptions = exceptions.get();
 
+        // settings may have changed in place
+        m_titleBarFonts.clear();
+
+    }
+
+    //__________________________________________________________________
+    TitleBarFontPtr SettingsProvider::titleBarFont( const InternalSettingsPtr& internalSettings ) const
+    {
+
+        auto it = m_titleBarFonts.constFind( internalSettings.data() );
+        if( it != m_titleBarFonts.constEnd() ) return it.value();
+
+        QFont parsed;
+        parsed.fromString( internalSettings->titleBarFont() );
+
+        // KDE needs this FIXME: Why?
+        QFont styled( parsed );
+        QFontDatabase fd;
+        styled.setStyleName( fd.styleString( parsed ) );
+
+        const TitleBarFontPtr font( new TitleBarFont( parsed, styled ) );
+        m_titleBarFonts.insert( internalSettings.data(), font );
+        return font;
+
     }
 
     //__________________________________________________________________
@@ -26,11 +26,36 @@
 
 #include <KSharedConfig>
 
+#include <QFont>
+#include <QFontMetrics>
+#include <QHash>
 #include <QObject>
 
 namespace Breeze
 {
 
+    //* title bar font, parsed once per settings object
+    class TitleBarFont
+    {
+
+        public:
+
+        //* constructor
+        explicit TitleBarFont( const QFont& parsed, const QFont& styled ):
+            font( styled ),
+            metrics( parsed )
+        {}
+
+        //* font used to paint the caption, with its style name resolved
+        const QFont font;
+
+        //* metrics used to lay out the title bar
+        const QFontMetrics metrics;
+
+    };
+
+    using TitleBarFontPtr = QSharedPointer<const TitleBarFont>;
+
     class SettingsProvider: public QObject
     {
 
@@ -47,6 +72,9 @@ namespace Breeze
         //* internal settings for given decoration
         InternalSettingsPtr internalSettings(Decoration *) const;
 
+        //* title bar font of given settings, cached until the next reconfiguration
+        TitleBarFontPtr titleBarFont( const InternalSettingsPtr& ) const;
+
         public Q_SLOTS:
 
         //* reconfigure
@@ -63,6 +91,9 @@ namespace Breeze
         //* exceptions
         InternalSettingsList m_exceptions;
 
+        //* parsed title bar fonts, keyed by settings object
+        mutable QHash<const InternalSettings*, TitleBarFontPtr> m_titleBarFonts;
+
         //* config object
         KSharedConfigPtr m_config;
 
@@ -0,0 +1,45 @@
+#include "buttonrendercache.h"
+
+
+namespace Breeze
+{
+    namespace
+    {
+        // Cost is the size in bytes, a few thousands renders of usual button sizes
+        const int g_maxCost = 8 * 1024 * 1024;
+    }
+
+    ButtonRenderCache *ButtonRenderCache::self()
+    {
+        static ButtonRenderCache s_self;
+        return &s_self;
+    }
+
+    ButtonRenderCache::ButtonRenderCache()
+        : m_cache(g_maxCost)
+    {
+    }
+
+    QImage ButtonRenderCache::find(const Key &key) const
+    {
+        auto image = m_cache.object(key);
+        return image != nullptr ? *image : QImage();
+    }
+
+    void ButtonRenderCache::insert(const Key &key, const QImage &image)
+    {
+        m_cache.insert(key, new QImage(image), static_cast<int>(image.sizeInBytes()));
+    }
+
+    uint qHash(const ButtonRenderCache::Key &key, uint seed)
+    {
+        uint hash = ::qHash(key.type, seed);
+        hash = hash * 31 + ::qHash(key.iconSize << 16 | key.width, seed);
+        hash = hash * 31 + ::qHash(key.animation << 16 | key.flags, seed);
+        hash = hash * 31 + ::qHash(key.background, seed);
+        hash = hash * 31 + ::qHash(key.border, seed);
+        hash = hash * 31 + ::qHash(key.symbol, seed);
+        hash = hash * 31 + ::qHash(key.icon, seed);
+        return hash * 31 + ::qHash(key.devicePixelRatio, seed);
+    }
+}
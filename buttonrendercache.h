@@ -0,0 +1,82 @@
+#ifndef BUTTON_RENDER_CACHE_H
+#define BUTTON_RENDER_CACHE_H
+
+/*
+ * Copyright 2020  Alejandro Romero Rivera <k1r0d3v@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCache>
+#include <QImage>
+
+
+namespace Breeze
+{
+    /**
+     * Process wide cache of rendered buttons, shared by the buttons of every decoration.
+     */
+    class ButtonRenderCache
+    {
+    public:
+        struct Key
+        {
+            int type; // Button type, each type draws its own symbol
+            int iconSize;
+            int width; // Button width, some symbols scale their pen with it
+            int animation; // Quantized animation value
+            uint flags; // State flags and theme visibility flags
+            QRgb background;
+            QRgb border;
+            QRgb symbol;
+            qint64 icon; // Cache key of the client icon, 0 for the buttons not painting it
+            qreal devicePixelRatio;
+
+            bool operator==(const Key &other) const
+            {
+                return type == other.type && iconSize == other.iconSize && width == other.width
+                    && animation == other.animation && flags == other.flags && background == other.background
+                    && border == other.border && symbol == other.symbol && icon == other.icon
+                    && devicePixelRatio == other.devicePixelRatio;
+            }
+        };
+
+        /**
+         * @return The cache instance
+         */
+        static ButtonRenderCache *self();
+
+        /**
+         * @return The cached render of the key, a null image when there is none
+         */
+        QImage find(const Key &key) const;
+
+        /**
+         * Cache the render of the key, evicting the least recently used renders when full
+         */
+        void insert(const Key &key, const QImage &image);
+
+    private:
+        ButtonRenderCache();
+
+        QCache<Key, QImage> m_cache;
+    };
+
+    uint qHash(const ButtonRenderCache::Key &key, uint seed = 0);
+}
+
+#endif
@@ -1,7 +1,10 @@
 #include "config-breeze.h"
 #include "clientutil.h"
+#include "samplingservice.h"
 
-#include <queue>
+#include <QElapsedTimer>
+#include <QFutureInterface>
+#include <QDebug>
 
 #if BREEZE_HAVE_X11
 #include <QX11Info>
@@ -9,17 +12,339 @@
 
 #include <X11/extensions/Xcomposite.h>
 #include <X11/extensions/Xrender.h>
+#include <X11/extensions/XShm.h>
+
+#include <xcb/xcb.h>
+#include <xcb/shm.h>
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
 
 #include "QtX11ImageConversion.h"
 #endif
 
 
+#if BREEZE_HAVE_X11
+struct ClientUtil::X11Resources
+{
+    // Window resources, they live as long as the client
+    Picture windowPicture = None;
+    XRenderPictFormat *format = nullptr;
+    Visual *visual = nullptr;
+    int depth = 0;
+    bool hasAlpha = false;
+    QSize windowSize;
+
+    // Render buffers, recreated when the render size changes
+    Pixmap pixmap = None;
+    Picture pixmapPicture = None;
+    XImage *image = nullptr;
+    QSize size;
+
+    // Shared memory readback, the image data is the shared segment
+    XShmSegmentInfo shm = {};
+    XImage *shmImage = nullptr;
+};
+
+namespace
+{
+    const int g_replyTimeout = 1000;
+
+    bool g_shmAttachFailed = false;
+
+    int shmAttachErrorHandler(Display *display, XErrorEvent *event)
+    {
+        Q_UNUSED(display)
+        Q_UNUSED(event)
+        g_shmAttachFailed = true;
+        return 0;
+    }
+}
+#else
+struct ClientUtil::X11Resources
+{
+};
+#endif
+
+struct ClientUtil::PendingRequest
+{
+    QFutureInterface<ClientUtil::ColorSample> interface;
+    ClientUtil::SamplingStrategy strategy = ClientUtil::SamplingStrategy::Full;
+    unsigned int sequence = 0;
+    bool sent = false;
+    bool shm = false;
+    QSize size;
+    QElapsedTimer elapsed;
+};
+
 ClientUtil::ClientUtil(const QWindow &window)
     : m_window(window)
 {
 
 }
 
+ClientUtil::~ClientUtil()
+{
+    if (m_pending != nullptr)
+    {
+        SamplingService::self()->cancel(this);
+
+#if BREEZE_HAVE_X11
+        if (m_pending->sent)
+            xcb_discard_reply(QX11Info::connection(), m_pending->sequence);
+#endif
+
+        m_pending->interface.reportFinished();
+    }
+
+    releaseResources();
+}
+
+void ClientUtil::setClientSize(const QSize &size)
+{
+    m_clientSize = size;
+}
+
+void ClientUtil::setSamplingStride(int stride)
+{
+    m_samplingStride = std::max(1, stride);
+}
+
+bool ClientUtil::initializeResources()
+{
+#if BREEZE_HAVE_X11
+    if (m_x11 != nullptr)
+        return true;
+
+    auto display = QX11Info::display();
+
+    // Make sure we have the RENDER extension
+    static const bool hasRender = []() {
+        int render_event_base, render_error_base;
+        return XRenderQueryExtension(QX11Info::display(), &render_event_base, &render_error_base);
+    }();
+
+    if (!hasRender) {
+        qDebug() << "ClientUtil: error: No RENDER extension found";
+        return false;
+    }
+
+    // Get the window attributes and render format of our window, the visual does not change for the window lifetime
+    XWindowAttributes attr;
+    if (!XGetWindowAttributes(display, m_window.winId(), &attr))
+        return false;
+
+    auto resources = std::make_unique<X11Resources>();
+    resources->format = XRenderFindVisualFormat(display, attr.visual);
+    if (resources->format == nullptr)
+    {
+        qDebug() << "ClientUtil: XRenderFindVisualFormat error: No render format for the window visual";
+        return false;
+    }
+
+    resources->visual = attr.visual;
+    resources->depth = attr.depth;
+    resources->hasAlpha = resources->format->type == PictTypeDirect && resources->format->direct.alphaMask;
+    resources->windowSize = QSize(attr.width, attr.height);
+
+    // Redirect window to an offscreen buffer
+    XCompositeRedirectWindow(display, m_window.winId(), CompositeRedirectAutomatic);
+
+    XRenderPictureAttributes pa;
+    pa.subwindow_mode = IncludeInferiors; // Don't clip child widgets
+
+    resources->windowPicture = XRenderCreatePicture(display, m_window.winId(), resources->format, CPSubwindowMode, &pa);
+    if (resources->windowPicture == None)
+    {
+        XCompositeUnredirectWindow(display, m_window.winId(), CompositeRedirectAutomatic);
+        qDebug() << "ClientUtil: XRenderCreatePicture error: Could not create the window picture";
+        return false;
+    }
+
+    m_x11 = std::move(resources);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ClientUtil::updateRenderBuffers(const QSize &size)
+{
+#if BREEZE_HAVE_X11
+    if (m_x11->pixmap != None && m_x11->size == size)
+        return true;
+
+    releaseRenderBuffers();
+
+    auto display = QX11Info::display();
+
+    // Create a temporal picture to render the window
+    m_x11->pixmap = XCreatePixmap(display, m_window.winId(), size.width(), size.height(), m_x11->depth);
+    if (m_x11->pixmap == None)
+    {
+        qDebug() << "ClientUtil: XCreatePixmap error: Failed to create pixmap";
+        return false;
+    }
+
+    m_x11->pixmapPicture = XRenderCreatePicture(display, m_x11->pixmap, m_x11->format, 0, nullptr);
+    if (m_x11->pixmapPicture == None)
+    {
+        releaseRenderBuffers();
+        qDebug() << "ClientUtil: XRenderCreatePicture error: Failed to create picture";
+        return false;
+    }
+
+    m_x11->size = size;
+
+    createShmImage();
+
+    return true;
+#else
+    Q_UNUSED(size)
+    return false;
+#endif
+}
+
+void ClientUtil::createShmImage()
+{
+#if BREEZE_HAVE_X11
+    auto display = QX11Info::display();
+
+    // Shared memory is only available on local connections
+    static const bool hasShm = XShmQueryExtension(display);
+    if (!hasShm)
+        return;
+
+    auto &shm = m_x11->shm;
+    auto image = XShmCreateImage(display, m_x11->visual, m_x11->depth, ZPixmap, nullptr, &shm,
+                                 m_x11->size.width(), m_x11->size.height());
+    if (image == nullptr)
+        return;
+
+    shm.shmid = shmget(IPC_PRIVATE, image->bytes_per_line * image->height, IPC_CREAT | 0600);
+    if (shm.shmid < 0)
+    {
+        XDestroyImage(image);
+        return;
+    }
+
+    shm.shmaddr = image->data = static_cast<char*>(shmat(shm.shmid, nullptr, 0));
+    shm.readOnly = False;
+
+    // The attach fails asynchronously on remote connections, catch it here instead of in the global handler
+    g_shmAttachFailed = false;
+    auto oldHandler = XSetErrorHandler(shmAttachErrorHandler);
+    const bool attached = shm.shmaddr != reinterpret_cast<char*>(-1) && XShmAttach(display, &shm);
+    XSync(display, False);
+    XSetErrorHandler(oldHandler);
+
+    // Marked for deletion, the segment is released once both sides detach it
+    shmctl(shm.shmid, IPC_RMID, nullptr);
+
+    if (!attached || g_shmAttachFailed)
+    {
+        qDebug() << "ClientUtil: XShmAttach error: Falling back to XGetImage";
+
+        if (shm.shmaddr != reinterpret_cast<char*>(-1))
+            shmdt(shm.shmaddr);
+
+        image->data = nullptr;
+        XDestroyImage(image);
+        shm = {};
+        return;
+    }
+
+    m_x11->shmImage = image;
+#endif
+}
+
+void ClientUtil::releaseRenderBuffers()
+{
+#if BREEZE_HAVE_X11
+    // It may point to the shared segment
+    m_topLine = QImage();
+
+    auto display = QX11Info::display();
+
+    if (m_x11->shmImage != nullptr)
+    {
+        XShmDetach(display, &m_x11->shm);
+        shmdt(m_x11->shm.shmaddr);
+
+        // The data is the shared segment, do not let Xlib free it
+        m_x11->shmImage->data = nullptr;
+        XDestroyImage(m_x11->shmImage);
+        m_x11->shmImage = nullptr;
+        m_x11->shm = {};
+    }
+
+    if (m_x11->pixmapPicture != None)
+        XRenderFreePicture(display, m_x11->pixmapPicture);
+
+    if (m_x11->pixmap != None)
+        XFreePixmap(display, m_x11->pixmap);
+
+    if (m_x11->image != nullptr)
+        XDestroyImage(m_x11->image);
+
+    m_x11->pixmapPicture = None;
+    m_x11->pixmap = None;
+    m_x11->image = nullptr;
+    m_x11->size = QSize();
+#endif
+}
+
+void ClientUtil::releaseResources()
+{
+#if BREEZE_HAVE_X11
+    if (m_x11 == nullptr)
+        return;
+
+    releaseRenderBuffers();
+
+    auto display = QX11Info::display();
+    XRenderFreePicture(display, m_x11->windowPicture);
+
+    // Release offscreen redirection
+    XCompositeUnredirectWindow(display, m_window.winId(), CompositeRedirectAutomatic);
+
+    m_x11.reset();
+#endif
+}
+
+QSize ClientUtil::renderToBuffers(int resultWidth, int resultHeight)
+{
+#if BREEZE_HAVE_X11
+    if (!initializeResources())
+        return {};
+
+    auto display = QX11Info::display();
+
+    // Prefer the size reported by the decoration, it avoids a round trip on each render
+    const QSize windowSize = m_clientSize.isValid() ? m_clientSize : m_x11->windowSize;
+    int width = windowSize.width();
+    int height = windowSize.height();
+
+    if (resultWidth >= 0)
+        width = std::max(1, std::min(width, resultWidth));
+
+    if (resultHeight >= 0)
+        height = std::max(1, std::min(height, resultHeight));
+
+    if (!updateRenderBuffers(QSize(width, height)))
+        return {};
+
+    // Render and tell the server to complete the operation
+    XRenderComposite(display, m_x11->hasAlpha ? PictOpOver : PictOpSrc, m_x11->windowPicture, None, m_x11->pixmapPicture, 0, 0, 0, 0, 0, 0, width, height);
+
+    return { width, height };
+#else
+    Q_UNUSED(resultWidth)
+    Q_UNUSED(resultHeight)
+    return {};
+#endif
+}
+
 QImage ClientUtil::renderToImage(int resultWidth, int resultHeight)
 {
 #if BREEZE_HAVE_X11
@@ -48,127 +373,252 @@ QImage ClientUtil::renderToImage(int resultWidth, int resultHeight)
         return image;
     }
 
-    auto display = QX11Info::display();
+#if BREEZE_HAVE_X11
+    // A pending request owns the render buffers
+    if (m_pending != nullptr)
+        return {};
 
-    // Make sure we have the RENDER extension
-    int render_event_base, render_error_base;
-    if(!XRenderQueryExtension(display, &render_event_base, &render_error_base)) {
-        qDebug() << "ClientUtil: error: No RENDER extension found";
+    const QSize size = renderToBuffers(resultWidth, resultHeight);
+    if (!size.isValid())
         return {};
-    }
 
-    // Redirect window to an offscreen buffer
-    XCompositeRedirectWindow(display, m_window.winId(), CompositeRedirectAutomatic);
+    auto display = QX11Info::display();
 
-    // Get the window attributes and render format of our window
-    XWindowAttributes attr;
-    if (!XGetWindowAttributes(display, m_window.winId(), &attr))
+    // Read the pixels straight into the shared segment, no copies through the socket nor on our side
+    if (m_x11->shmImage != nullptr)
     {
-        // Release offscreen redirection
-        XCompositeUnredirectWindow(display, m_window.winId(), CompositeRedirectAutomatic);
-        return {};
+        if (XShmGetImage(display, m_x11->pixmap, m_x11->shmImage, 0, 0, AllPlanes))
+            return qimageFromXImageInPlace(m_x11->shmImage);
+
+        qDebug() << "ClientUtil: XShmGetImage error: Falling back to XGetImage";
     }
-    XRenderPictFormat *format = XRenderFindVisualFormat(display, attr.visual);
-    int width                 = attr.width;
-    int height                = attr.height;
 
-    XRenderPictureAttributes pa;
-    pa.subwindow_mode = IncludeInferiors; // Don't clip child widgets
+    // Reuse the image of the previous render when possible
+    XImage *windowResultImage = m_x11->image != nullptr
+            ? XGetSubImage(display, m_x11->pixmap, 0, 0, size.width(), size.height(), AllPlanes, ZPixmap, m_x11->image, 0, 0)
+            : XGetImage(display, m_x11->pixmap, 0, 0, size.width(), size.height(), AllPlanes, ZPixmap);
 
-    //
-    auto windowId = m_window.winId();
-    auto windowPicture = XRenderCreatePicture(display, windowId, format, CPSubwindowMode, &pa);
-    if (windowPicture == None)
+    if (windowResultImage == nullptr)
     {
-        qDebug() << "ClientUtil: XRenderCreatePicture error: Could not create the window picture";
+        // The client may be gone, start again from scratch on the next render
+        releaseResources();
+        qDebug() << "ClientUtil: XGetImage error: Invalid render result";
         return {};
     }
 
-    if (resultWidth >= 0)
-        width = std::max(1, std::min(width, resultWidth));
+    m_x11->image = windowResultImage;
 
-    if (resultHeight >= 0)
-        height = std::max(1, std::min(height, resultHeight));
+    // The image is kept for the next render, so convert it in place instead of copying it
+    return qimageFromXImageInPlace(windowResultImage);
+#else
+    return {};
+#endif
+}
 
-    bool hasAlpha             = format->type == PictTypeDirect && format->direct.alphaMask;
-    int depth                 = attr.depth;
+QColor ClientUtil::topLineColor()
+{
+    return sampleImage(renderToImage(-1, TopLineRows), SamplingStrategy::Full).color;
+}
 
-    // Create a temporal picture to render the window
-    auto windowTmpPixmap = XCreatePixmap(display, windowId, width, height, depth);
-    if (windowTmpPixmap == None)
+ClientUtil::ColorSample ClientUtil::sampleTopLine(SamplingStrategy strategy)
+{
+    return sampleImage(m_topLine, strategy);
+}
+
+QFuture<ClientUtil::ColorSample> ClientUtil::requestTopLineColor(SamplingStrategy strategy)
+{
+    // Share the request in flight, its capture is sampled once the reply arrives so a full scan can still be asked
+    if (m_pending != nullptr)
     {
-        XRenderFreePicture(display, windowPicture);
-        qDebug() << "ClientUtil: XCreatePixmap error: Failed to create pixmap";
-        return {};
+        if (strategy == SamplingStrategy::Full)
+            m_pending->strategy = strategy;
+
+        return m_pending->interface.future();
     }
 
-    auto windowTmpPicture = XRenderCreatePicture(display, windowTmpPixmap, format, None, &pa);
-    if (windowTmpPicture == None)
+#if BREEZE_HAVE_X11
+    // Screen capture has no asynchronous path
+    if (QX11Info::isCompositingManagerRunning())
     {
-        XRenderFreePicture(display, windowPicture);
-        XFreePixmap(display, windowTmpPixmap);
-        qDebug() << "ClientUtil: XRenderCreatePicture error: Failed to create picture";
-        return {};
+        // The sampling service batches the requests of all the clients made in this event loop pass
+        m_pending = std::make_unique<PendingRequest>();
+        m_pending->strategy = strategy;
+        m_pending->interface.reportStarted();
+        SamplingService::self()->enqueue(this);
+        return m_pending->interface.future();
     }
+#endif
 
-    // Render and tell the server to complete the operation
-    XRenderComposite(display, hasAlpha ? PictOpOver : PictOpSrc, windowPicture, None, windowTmpPicture, 0, 0, 0, 0, 0, 0, width, height);
-    //XFlush(display);
+    m_topLine = renderToImage(-1, TopLineRows);
+
+    QFutureInterface<ColorSample> interface;
+    interface.reportStarted();
+    interface.reportResult(sampleTopLine(strategy));
+    interface.reportFinished();
+    return interface.future();
+}
+
+bool ClientUtil::beginPendingRequest()
+{
+    // The new capture may overwrite its pixels
+    m_topLine = QImage();
+
+#if BREEZE_HAVE_X11
+    // Only queues the composite, it is sent along the other clients requests
+    m_pending->size = renderToBuffers(-1, TopLineRows);
+    if (m_pending->size.isValid())
+        return true;
+#endif
 
-    //
-    auto windowResultImage = XGetImage(display, windowTmpPixmap, 0, 0, width, height, AllPlanes, ZPixmap);
-    if (windowResultImage == None)
+    finishPendingRequest({});
+    return false;
+}
+
+void ClientUtil::sendPendingRequest()
+{
+#if BREEZE_HAVE_X11
+    auto connection = QX11Info::connection();
+    const QSize size = m_pending->size;
+
+    m_pending->shm = m_x11->shmImage != nullptr;
+    if (m_pending->shm)
     {
-        // Release offscreen redirection
-        XCompositeUnredirectWindow(display, m_window.winId(), CompositeRedirectAutomatic);
+        m_pending->sequence = xcb_shm_get_image(connection, m_x11->pixmap, 0, 0, size.width(), size.height(), ~0u,
+                                                XCB_IMAGE_FORMAT_Z_PIXMAP, m_x11->shm.shmseg, 0).sequence;
+    }
+    else
+    {
+        m_pending->sequence = xcb_get_image(connection, XCB_IMAGE_FORMAT_Z_PIXMAP, m_x11->pixmap, 0, 0,
+                                            size.width(), size.height(), ~0u).sequence;
+    }
 
-        XRenderFreePicture(display, windowPicture);
-        XFreePixmap(display, windowTmpPixmap);
-        XRenderFreePicture(display, windowTmpPicture);
-        qDebug() << "ClientUtil: XGetImage error: Invalid render result";
-        return {};
+    m_pending->sent = true;
+    m_pending->elapsed.start();
+#endif
+}
+
+bool ClientUtil::pollPendingRequest()
+{
+#if BREEZE_HAVE_X11
+    auto connection = QX11Info::connection();
+
+    void *reply = nullptr;
+    xcb_generic_error_t *error = nullptr;
+    if (!xcb_poll_for_reply(connection, m_pending->sequence, &reply, &error))
+    {
+        if (m_pending->elapsed.elapsed() < g_replyTimeout)
+            return false;
+
+        qDebug() << "ClientUtil: warning: Timeout waiting for the client image";
+        xcb_discard_reply(connection, m_pending->sequence);
+        finishPendingRequest({});
+        return true;
     }
 
-    // Release offscreen redirection
-    XCompositeUnredirectWindow(display, m_window.winId(), CompositeRedirectAutomatic);
+    if (error != nullptr)
+    {
+        free(error);
+
+        // The client may be gone, start again from scratch on the next render
+        releaseResources();
+        finishPendingRequest({});
+        return true;
+    }
+
+    if (m_pending->shm)
+    {
+        // The pixels are already in the shared segment
+        m_topLine = qimageFromXImageInPlace(m_x11->shmImage);
+    }
+    else
+    {
+        auto imageReply = static_cast<xcb_get_image_reply_t *>(reply);
+        const int length = xcb_get_image_data_length(imageReply);
+        const int height = m_pending->size.height();
 
-    //
-    QImage image = qimageFromXImage(windowResultImage);
+        m_topLine = qimageFromXImageData(xcb_get_image_data(imageReply), m_pending->size.width(), height,
+                                         height > 0 ? length / height : 0, imageReply->depth,
+                                         xcb_get_setup(connection)->image_byte_order);
+    }
 
-    // Free resources
-    XRenderFreePicture(display, windowPicture);
-    XFreePixmap(display, windowTmpPixmap);
-    XRenderFreePicture(display, windowTmpPicture);
-    XDestroyImage(windowResultImage);
+    free(reply);
+    finishPendingRequest(sampleTopLine(m_pending->strategy));
+#endif
+    return true;
+}
 
-    return image;
+void ClientUtil::finishPendingRequest(const ColorSample &sample)
+{
+    // Reset before reporting, the result handlers may issue a new request
+    auto pending = std::move(m_pending);
+    pending->interface.reportResult(sample);
+    pending->interface.reportFinished();
 }
 
-QColor ClientUtil::topLineColor()
+ClientUtil::ColorSample ClientUtil::sampleImage(const QImage &source, SamplingStrategy strategy)
 {
-    auto image = renderToImage(-1, 2);
-    if (image.isNull())
+    if (source.isNull())
         return {};
 
-    // Get the color from the mode of the first two rows of the client pixels
-    QMap<QRgb, int> colorCount;
-    QPair<QRgb, int> modeColor = {0, 0};
-    for (int j = 0; j < image.height() ; ++j)
+    // The scanlines are read directly as 32 bit pixels
+    const QImage image = source.format() == QImage::Format_RGB32
+            || source.format() == QImage::Format_ARGB32
+            || source.format() == QImage::Format_ARGB32_Premultiplied
+            ? source : source.convertToFormat(QImage::Format_RGB32);
+
+    const QRgb orMask = image.format() == QImage::Format_RGB32 ? 0xff000000 : 0;
+    const int width = image.width();
+    const int step = strategy == SamplingStrategy::Strided ? m_samplingStride : 1;
+
+    // Counts are checked for a majority color every chunk of pixels
+    const int chunk = 256;
+    const int planned = strategy == SamplingStrategy::Probe
+            ? image.height() * std::min(width, static_cast<int>(ProbePoints))
+            : image.height() * ((width + step - 1) / step);
+
+    // Get the color from the mode of the first rows of the client pixels
+    m_histogram.clear(planned);
+    for (int j = 0; j < image.height(); ++j)
     {
-        for (int i = 0; i < image.width(); ++i)
+        auto line = reinterpret_cast<const QRgb *>(image.constScanLine(j));
+
+        if (strategy == SamplingStrategy::Probe)
         {
-            auto color = image.pixelColor(i, j).rgb();
+            const int points = std::min(width, static_cast<int>(ProbePoints));
+            for (int k = 0; k < points; ++k)
+                m_histogram.add(line[(2 * k + 1) * width / (2 * points)] | orMask, 1);
+            continue;
+        }
 
-            if (!colorCount.contains(color))
-                colorCount[color] = 1;
+        for (int i = 0; i < width; i += chunk * step)
+        {
+            const int end = std::min(width, i + chunk * step);
+            if (step == 1)
+            {
+                m_histogram.addPixels(line + i, end - i, orMask);
+            }
             else
-                colorCount[color] += 1;
-
-            auto count = colorCount[color];
-            if (count > modeColor.second)
-                modeColor = {color, count};
+            {
+                for (int x = i; x < end; x += step)
+                    m_histogram.add(line[x] | orMask, 1);
+            }
+
+            // No other color can be the mode anymore
+            if (2 * m_histogram.modeCount() > planned)
+                break;
         }
+
+        if (2 * m_histogram.modeCount() > planned)
+            break;
     }
 
-    return QColor::fromRgb(modeColor.first);
+    if (m_histogram.total() == 0)
+        return {};
+
+    const QRgb mode = m_histogram.mode();
+
+    ColorSample sample;
+    sample.color = QColor::fromRgb(image.format() == QImage::Format_ARGB32_Premultiplied ? qUnpremultiply(mode) : mode);
+    sample.confidence = static_cast<qreal>(m_histogram.modeCount()) / m_histogram.total();
+    return sample;
 }
@@ -21,20 +21,116 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "colorhistogram.h"
+
 #include <QWindow>
+#include <QFuture>
+
+#include <memory>
 
+class SamplingService;
 
 class ClientUtil
 {
 
 public:
+    // Number of rows from the top of the client sampled by topLineColor
+    static constexpr int TopLineRows = 2;
+
+    // Number of points of each row sampled by the probe strategy
+    static constexpr int ProbePoints = 8;
+
+    enum class SamplingStrategy
+    {
+        Full, // Every pixel, stops once a color holds the majority
+        Strided, // Every Nth pixel, stops once a color holds the majority
+        Probe // A few fixed points of each row
+    };
+
+    struct ColorSample
+    {
+        QColor color = {};
+        qreal confidence = 0; // Fraction of the examined pixels of the color, in range [0, 1]
+    };
+
     explicit ClientUtil(const QWindow &window);
 
+    ~ClientUtil();
+
+    ClientUtil(const ClientUtil &) = delete;
+    ClientUtil &operator=(const ClientUtil &) = delete;
+
+    /**
+     * Set the current client size, the render buffers are recreated on the next render if it changed
+     */
+    void setClientSize(const QSize &size);
+
+    /**
+     * Set the distance between the pixels examined by the strided strategy
+     */
+    void setSamplingStride(int stride);
+
+    /**
+     * Render the client top left area.
+     * The image may share memory with the internal buffers, it is valid until the next render.
+     */
     QImage renderToImage(int width = -1, int height = -1);
 
     QColor topLineColor();
+
+    /**
+     * Asynchronous version of topLineColor.
+     * The sample is reported once the X server replies, the event loop is never blocked waiting for it.
+     * Only a request is in flight at a time, calls made meanwhile share the pending future.
+     * A call asking for the full strategy meanwhile makes the pending request use it.
+     *
+     * @param strategy The strategy used to sample the captured top line
+     * @see SamplingService
+     */
+    QFuture<ColorSample> requestTopLineColor(SamplingStrategy strategy = SamplingStrategy::Full);
+
+    /**
+     * Sample again the top line captured by the last finished request, without capturing it again
+     */
+    ColorSample sampleTopLine(SamplingStrategy strategy);
 private:
+    friend class SamplingService;
+
+    // X resources kept alive between renders, recreated only when the client is resized
+    struct X11Resources;
+
+    // Image request in flight
+    struct PendingRequest;
+
+    ColorSample sampleImage(const QImage &source, SamplingStrategy strategy);
+
+    bool initializeResources();
+
+    bool updateRenderBuffers(const QSize &size);
+
+    void createShmImage();
+
+    QSize renderToBuffers(int width, int height);
+
+    bool beginPendingRequest();
+
+    void sendPendingRequest();
+
+    bool pollPendingRequest();
+
+    void finishPendingRequest(const ColorSample &sample);
+
+    void releaseRenderBuffers();
+
+    void releaseResources();
+
     const QWindow &m_window;
+    std::unique_ptr<X11Resources> m_x11;
+    std::unique_ptr<PendingRequest> m_pending;
+    ColorHistogram m_histogram;
+    QImage m_topLine; // Captured by the last request, it may share memory with the render buffers
+    int m_samplingStride = 4;
+    QSize m_clientSize;
 };
 
 #endif
@@ -0,0 +1,123 @@
+#include "colorhistogram.h"
+
+#include <QtAlgorithms>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace
+{
+    inline quint32 bucketHash(QRgb color)
+    {
+        // Fibonacci hashing, the high bits are the best mixed ones
+        return (color * 2654435769u) ^ ((color * 2654435769u) >> 16);
+    }
+
+    /**
+     * @return The number of pixels equal to the first one, starting from it
+     */
+    inline int runLength(const QRgb *pixels, int count, QRgb orMask)
+    {
+        const QRgb color = pixels[0] | orMask;
+        int run = 1;
+
+#ifdef __SSE2__
+        // Compare four pixels at once, toolbars are usually long runs of a single color
+        const __m128i needle = _mm_set1_epi32(static_cast<int>(color));
+        const __m128i mask = _mm_set1_epi32(static_cast<int>(orMask));
+        while (run + 4 <= count)
+        {
+            const __m128i v = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + run)), mask);
+            const uint equal = static_cast<uint>(_mm_movemask_epi8(_mm_cmpeq_epi32(v, needle)));
+            if (equal != 0xffff)
+                return run + static_cast<int>(qCountTrailingZeroBits(~equal)) / 4;
+            run += 4;
+        }
+#endif
+
+        while (run < count && (pixels[run] | orMask) == color)
+            ++run;
+
+        return run;
+    }
+}
+
+void ColorHistogram::clear(int colors)
+{
+    // Keep the table at most half full
+    int capacity = 16;
+    while (capacity < 2 * colors)
+        capacity *= 2;
+
+    if (capacity > m_buckets.size())
+    {
+        m_buckets.fill({ 0, 0 }, capacity);
+        m_used.reserve(capacity / 2);
+        m_mask = static_cast<quint32>(capacity - 1);
+    }
+    else
+    {
+        // Only touch the buckets in use
+        for (int index : qAsConst(m_used))
+            m_buckets[index].count = 0;
+    }
+
+    m_used.clear();
+    m_mode = 0;
+    m_modeCount = 0;
+    m_total = 0;
+}
+
+void ColorHistogram::addPixels(const QRgb *pixels, int count, QRgb orMask)
+{
+    int i = 0;
+    while (i < count)
+    {
+        const int run = runLength(pixels + i, count - i, orMask);
+        add(pixels[i] | orMask, run);
+        i += run;
+    }
+}
+
+void ColorHistogram::add(QRgb color, int count)
+{
+    // Grow when the table gets half full, the counts are moved to the new table
+    if (2 * (m_used.size() + 1) > m_buckets.size())
+    {
+        const auto buckets = m_buckets;
+        const auto used = m_used;
+        const QRgb mode = m_mode;
+        const int modeCount = m_modeCount;
+        const int total = m_total;
+
+        clear(m_buckets.size());
+        for (int index : used)
+            add(buckets[index].color, buckets[index].count);
+
+        m_mode = mode;
+        m_modeCount = modeCount;
+        m_total = total;
+    }
+
+    quint32 index = bucketHash(color) & m_mask;
+    while (m_buckets[index].count != 0 && m_buckets[index].color != color)
+        index = (index + 1) & m_mask;
+
+    auto &bucket = m_buckets[index];
+    if (bucket.count == 0)
+    {
+        bucket.color = color;
+        m_used.append(static_cast<int>(index));
+    }
+
+    bucket.count += count;
+    m_total += count;
+
+    if (bucket.count > m_modeCount)
+    {
+        m_mode = color;
+        m_modeCount = bucket.count;
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef COLOR_HISTOGRAM_H
+#define COLOR_HISTOGRAM_H
+
+/*
+ * Copyright 2020  Alejandro Romero Rivera <k1r0d3v@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QRgb>
+#include <QVector>
+
+
+/**
+ * Color counter used to find the mode color of a set of pixels.
+ *
+ * Colors are counted in a flat open addressing table which keeps its storage between uses,
+ * runs of identical pixels are counted at once.
+ */
+class ColorHistogram
+{
+public:
+    /**
+     * Reset the counts, making room for at least the given number of different colors
+     */
+    void clear(int colors);
+
+    /**
+     * Count a run of pixels
+     *
+     * @param pixels The pixels
+     * @param count The number of pixels
+     * @param orMask Mask or-ed to each pixel before counting it, e.g. 0xff000000 to ignore the alpha byte
+     */
+    void addPixels(const QRgb *pixels, int count, QRgb orMask = 0);
+
+    /**
+     * Count the color the given number of times
+     */
+    void add(QRgb color, int count);
+
+    /**
+     * @return The most repeated color, the first one counted on ties
+     */
+    QRgb mode() const
+    {
+        return m_mode;
+    }
+
+    /**
+     * @return The number of times the mode color was counted
+     */
+    int modeCount() const
+    {
+        return m_modeCount;
+    }
+
+    /**
+     * @return The number of counted pixels
+     */
+    int total() const
+    {
+        return m_total;
+    }
+
+private:
+    struct Bucket
+    {
+        QRgb color;
+        int count; // Zero for free buckets
+    };
+
+    QVector<Bucket> m_buckets;
+    QVector<int> m_used; // Indices of the non free buckets
+    quint32 m_mask = 0;
+    QRgb m_mode = 0;
+    int m_modeCount = 0;
+    int m_total = 0;
+};
+
+#endif
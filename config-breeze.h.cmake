@@ -25,4 +25,7 @@
 /* Define to 1 if XCB libraries are found */
 #cmakedefine01 BREEZE_HAVE_X11
 
+/* Define to 1 if the compositor scales the decoration shadows by their texture device pixel ratio, KWin 5 does not */
+#cmakedefine01 BREEZE_SCALED_SHADOWS
+
 #endif
@@ -0,0 +1,153 @@
+#include "config-breeze.h"
+#include "damagetracker.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+
+#if BREEZE_HAVE_X11
+#include <QX11Info>
+
+#include <xcb/xcb.h>
+#include <xcb/damage.h>
+#endif
+
+
+namespace Breeze
+{
+    DamageTracker *DamageTracker::self()
+    {
+        static DamageTracker s_self;
+        return &s_self;
+    }
+
+    DamageTracker::DamageTracker()
+    {
+#if BREEZE_HAVE_X11
+        if (!QX11Info::isPlatformX11())
+            return;
+
+        auto connection = QX11Info::connection();
+        auto extension = xcb_get_extension_data(connection, &xcb_damage_id);
+        if (extension == nullptr || !extension->present)
+        {
+            qDebug() << "DamageTracker: warning: No DAMAGE extension found";
+            return;
+        }
+
+        // The version must be negotiated before using any other request of the extension
+        auto cookie = xcb_damage_query_version(connection, XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION);
+        auto reply = xcb_damage_query_version_reply(connection, cookie, nullptr);
+        if (reply == nullptr)
+            return;
+        free(reply);
+
+        m_eventBase = extension->first_event;
+        m_available = true;
+#endif
+    }
+
+    DamageTracker::~DamageTracker()
+    {
+        if (m_filterInstalled && QCoreApplication::instance() != nullptr)
+            QCoreApplication::instance()->removeNativeEventFilter(this);
+    }
+
+    bool DamageTracker::watch(WId window, int rows, Callback callback)
+    {
+#if BREEZE_HAVE_X11
+        if (!m_available)
+            return false;
+
+        unwatch(window);
+
+        auto connection = QX11Info::connection();
+        const xcb_damage_damage_t damage = xcb_generate_id(connection);
+
+        // Bounding box reports the whole damaged area each time it grows,
+        // the damage is repaired as soon as we get notified
+        xcb_damage_create(connection, damage, static_cast<xcb_drawable_t>(window), XCB_DAMAGE_REPORT_LEVEL_BOUNDING_BOX);
+        xcb_flush(connection);
+
+        m_watches.insert(damage, { window, rows, std::move(callback) });
+        m_damages.insert(window, damage);
+
+        if (!m_filterInstalled)
+        {
+            QCoreApplication::instance()->installNativeEventFilter(this);
+            m_filterInstalled = true;
+        }
+
+        return true;
+#else
+        Q_UNUSED(window)
+        Q_UNUSED(rows)
+        Q_UNUSED(callback)
+        return false;
+#endif
+    }
+
+    void DamageTracker::unwatch(WId window)
+    {
+#if BREEZE_HAVE_X11
+        auto it = m_damages.find(window);
+        if (it == m_damages.end())
+            return;
+
+        const xcb_damage_damage_t damage = it.value();
+        m_damages.erase(it);
+        m_watches.remove(damage);
+
+        // The server already released the damage if the window was destroyed, so ignore the error
+        auto connection = QX11Info::connection();
+        auto cookie = xcb_damage_destroy_checked(connection, damage);
+        xcb_discard_reply(connection, cookie.sequence);
+        xcb_flush(connection);
+
+        // Do not filter kwin events while nobody is listening
+        if (m_watches.isEmpty() && m_filterInstalled)
+        {
+            QCoreApplication::instance()->removeNativeEventFilter(this);
+            m_filterInstalled = false;
+        }
+#else
+        Q_UNUSED(window)
+#endif
+    }
+
+    bool DamageTracker::nativeEventFilter(const QByteArray &eventType, void *message, long *result)
+    {
+        Q_UNUSED(result)
+
+#if BREEZE_HAVE_X11
+        if (eventType != "xcb_generic_event_t")
+            return false;
+
+        auto event = static_cast<xcb_generic_event_t *>(message);
+        if ((event->response_type & ~0x80) != m_eventBase + XCB_DAMAGE_NOTIFY)
+            return false;
+
+        auto notify = reinterpret_cast<xcb_damage_notify_event_t *>(event);
+        auto it = m_watches.constFind(notify->damage);
+
+        // Not one of our damage objects, let kwin handle it
+        if (it == m_watches.constEnd())
+            return false;
+
+        // Repair the damage, so the next change reports again
+        xcb_damage_subtract(QX11Info::connection(), notify->damage, XCB_NONE, XCB_NONE);
+
+        if (notify->area.y < it->rows)
+        {
+            // The callback may unwatch the window, do not keep references into the hash
+            const Callback callback = it->callback;
+            callback();
+        }
+
+        return true;
+#else
+        Q_UNUSED(eventType)
+        Q_UNUSED(message)
+        return false;
+#endif
+    }
+}
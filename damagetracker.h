@@ -0,0 +1,98 @@
+#ifndef DAMAGE_TRACKER_H
+#define DAMAGE_TRACKER_H
+
+/*
+ * Copyright 2020  Alejandro Romero Rivera <k1r0d3v@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QAbstractNativeEventFilter>
+#include <QHash>
+#include <QWindow>
+
+#include <functional>
+
+
+namespace Breeze
+{
+    /**
+     * Process wide XDamage listener.
+     * Invokes the registered callback of a window when it reports damage inside its watched top rows.
+     */
+    class DamageTracker : public QAbstractNativeEventFilter
+    {
+    public:
+        using Callback = std::function<void()>;
+
+        /**
+         * @return The tracker instance
+         */
+        static DamageTracker *self();
+
+        /**
+         * Destructor
+         */
+        ~DamageTracker() override;
+
+        /**
+         * @return True when the XDamage extension is available
+         */
+        bool isAvailable() const
+        {
+            return m_available;
+        }
+
+        /**
+         * Start tracking the damage of the window first rows, replacing any previous watch of the window.
+         *
+         * @param window The client window
+         * @param rows The number of rows from the top of the window which are of interest
+         * @param callback Invoked each time the window is damaged inside the watched rows
+         * @return False when the window can not be tracked
+         */
+        bool watch(WId window, int rows, Callback callback);
+
+        /**
+         * Stop tracking the damage of the window
+         */
+        void unwatch(WId window);
+
+        /**
+         * @see QAbstractNativeEventFilter::nativeEventFilter
+         */
+        bool nativeEventFilter(const QByteArray &eventType, void *message, long *result) override;
+
+    private:
+        DamageTracker();
+
+        struct Watch
+        {
+            WId window;
+            int rows;
+            Callback callback;
+        };
+
+        QHash<quint32, Watch> m_watches; // Keyed by damage id
+        QHash<WId, quint32> m_damages; // Damage id of each window
+        int m_eventBase = 0;
+        bool m_available = false;
+        bool m_filterInstalled = false;
+    };
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include "framecorneratlas.h"
+
+#include <QPainter>
+
+#include <cmath>
+
+
+namespace Breeze
+{
+    namespace
+    {
+        // A few radii at the scales of the screens
+        const int g_maxMasks = 8;
+
+        // Cost is the size in bytes, a few hundred colors of usual radii
+        const int g_maxCornersCost = 1024 * 1024;
+    }
+
+    uint qHash(const FrameCornerAtlas::MaskKey &key, uint seed)
+    {
+        return ::qHash(key.radius, seed) ^ ::qHash(key.devicePixelRatio, seed);
+    }
+
+    uint qHash(const FrameCornerAtlas::Key &key, uint seed)
+    {
+        uint hash = ::qHash(key.color, seed);
+        hash = hash * 31 + ::qHash(key.radius, seed);
+        return hash * 31 + ::qHash(key.devicePixelRatio, seed);
+    }
+
+    FrameCornerAtlas *FrameCornerAtlas::self()
+    {
+        static FrameCornerAtlas s_self;
+        return &s_self;
+    }
+
+    FrameCornerAtlas::FrameCornerAtlas()
+        : m_masks(g_maxMasks)
+        , m_corners(g_maxCornersCost)
+    {
+    }
+
+    QImage FrameCornerAtlas::mask(const MaskKey &key)
+    {
+        if (auto mask = m_masks.object(key))
+            return *mask;
+
+        const int radius = key.radius;
+        const qreal devicePixelRatio = key.devicePixelRatio;
+
+        // At a fractional scale the arcs do not end on a device pixel, so each corner is padded
+        // to whole pixels on its inner sides and a blit never samples the neighbour corner
+        const int size = static_cast<int>(std::ceil(radius * devicePixelRatio));
+        QImage mask(2 * size, 2 * size, QImage::Format_ARGB32_Premultiplied);
+        mask.setDevicePixelRatio(devicePixelRatio);
+        mask.fill(Qt::transparent);
+
+        // Same arcs drawRoundedRect produces on each corner, the rounded rect is wider than
+        // the quadrant so the quadrant only sees one arc
+        {
+            const qreal quadrant = size / devicePixelRatio;
+            const qreal r = radius;
+
+            QPainter painter(&mask);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(Qt::white);
+            for (int y = 0; y < 2; ++y)
+            {
+                for (int x = 0; x < 2; ++x)
+                {
+                    painter.setClipRect(QRectF(x * quadrant, y * quadrant, quadrant, quadrant));
+                    painter.drawRoundedRect(QRectF(x * (2 * quadrant - 3 * r), y * (2 * quadrant - 3 * r), 3 * r, 3 * r), r, r);
+                }
+            }
+        }
+
+        m_masks.insert(key, new QImage(mask));
+        return mask;
+    }
+
+    QImage FrameCornerAtlas::corners(const Key &key)
+    {
+        if (auto corners = m_corners.object(key))
+            return *corners;
+
+        QImage corners = mask({ key.radius, key.devicePixelRatio });
+        {
+            QPainter painter(&corners);
+            painter.setCompositionMode(QPainter::CompositionMode_SourceIn);
+            painter.fillRect(QRectF(QPointF(0, 0), QSizeF(corners.size()) / key.devicePixelRatio), QColor::fromRgba(key.color));
+        }
+
+        m_corners.insert(key, new QImage(corners), static_cast<int>(corners.sizeInBytes()));
+        return corners;
+    }
+
+    void FrameCornerAtlas::fillRoundedRect(QPainter *painter, const QRect &rect, int radius, const QColor &color)
+    {
+        radius = qMin(radius, qMin(rect.width(), rect.height()) / 2);
+        if (radius <= 0)
+        {
+            painter->fillRect(rect, color);
+            return;
+        }
+
+        const qreal devicePixelRatio = painter->device()->devicePixelRatioF();
+        const QImage corners = this->corners({ color.rgba(), radius, devicePixelRatio });
+
+        // Source rects are in device pixels, their outer sides are on whole pixels and the
+        // inner sides fall in the padding of the same corner
+        const qreal end = corners.width();
+        const qreal d = radius * devicePixelRatio;
+        const int r = radius;
+        painter->drawImage(QRect(rect.left(), rect.top(), r, r), corners, QRectF(0, 0, d, d));
+        painter->drawImage(QRect(rect.right() + 1 - r, rect.top(), r, r), corners, QRectF(end - d, 0, d, d));
+        painter->drawImage(QRect(rect.left(), rect.bottom() + 1 - r, r, r), corners, QRectF(0, end - d, d, d));
+        painter->drawImage(QRect(rect.right() + 1 - r, rect.bottom() + 1 - r, r, r), corners, QRectF(end - d, end - d, d, d));
+
+        // Edges and center, without overlaps so translucent colors blend once
+        painter->fillRect(rect.adjusted(r, 0, -r, 0), color);
+        painter->fillRect(QRect(rect.left(), rect.top() + r, r, rect.height() - 2 * r), color);
+        painter->fillRect(QRect(rect.right() + 1 - r, rect.top() + r, r, rect.height() - 2 * r), color);
+    }
+}
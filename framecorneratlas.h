@@ -0,0 +1,98 @@
+#ifndef FRAME_CORNER_ATLAS_H
+#define FRAME_CORNER_ATLAS_H
+
+/*
+ * Copyright 2020  Alejandro Romero Rivera <k1r0d3v@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCache>
+#include <QImage>
+
+class QPainter;
+
+
+namespace Breeze
+{
+    /**
+     * Process wide atlas of antialiased frame corners.
+     * A rounded rect is filled as a nine-slice: plain rects for the edges and the center,
+     * and the cached corners, so the rasterization cost does not depend on the rect size.
+     *
+     * The corners are cached tinted with each frame color, so filling a frame is blits and plain fills
+     * only. Their colorless masks are kept too, a new color only tints a mask.
+     */
+    class FrameCornerAtlas
+    {
+    public:
+        /**
+         * @return The atlas instance
+         */
+        static FrameCornerAtlas *self();
+
+        /**
+         * Same as QPainter::drawRoundedRect(rect, radius, radius) with no pen and antialiasing
+         */
+        void fillRoundedRect(QPainter *painter, const QRect &rect, int radius, const QColor &color);
+
+    private:
+        FrameCornerAtlas();
+
+        struct MaskKey
+        {
+            int radius;
+            qreal devicePixelRatio;
+
+            bool operator==(const MaskKey &other) const
+            {
+                return radius == other.radius && devicePixelRatio == other.devicePixelRatio;
+            }
+        };
+
+        struct Key
+        {
+            QRgb color; // Frame color, with its alpha
+            int radius;
+            qreal devicePixelRatio;
+
+            bool operator==(const Key &other) const
+            {
+                return color == other.color && radius == other.radius && devicePixelRatio == other.devicePixelRatio;
+            }
+        };
+
+        friend uint qHash(const MaskKey &key, uint seed);
+        friend uint qHash(const Key &key, uint seed);
+
+        /**
+         * @return The four corners of a rounded rect in opaque white. Each corner has a quadrant of whole
+         * device pixels with its arc against the outer sides, the rest of the quadrant is inside the rect
+         */
+        QImage mask(const MaskKey &key);
+
+        /**
+         * @return The mask of the key tinted with its color, tinted on the first request
+         */
+        QImage corners(const Key &key);
+
+        QCache<MaskKey, QImage> m_masks;
+        QCache<Key, QImage> m_corners;
+    };
+}
+
+#endif
@@ -0,0 +1,102 @@
+#include "framepainter.h"
+
+#include "framecorneratlas.h"
+#include "titlebartilecache.h"
+
+#include <QPainter>
+#include <QRegion>
+
+
+namespace Breeze
+{
+    void FramePainter::paint(QPainter *painter, const Frame &frame, const QRect &repaintRect,
+                             const PaintContents &paintTitleBarContents)
+    {
+        const QRect paintRect = repaintRect & frame.rect;
+        if (paintRect.isEmpty())
+            return;
+
+        // Nothing outside the repaint rect is touched, a button hover only rasterizes the button area
+        painter->save();
+        painter->setClipRect(paintRect, Qt::IntersectClip);
+
+        // Paint background of borders
+        if (!frame.shaded)
+            paintBorders(painter, frame, paintRect);
+
+        // Paint title bar
+        const QRect titleRect(frame.rect.topLeft(), QSize(frame.rect.width(), frame.borders.top()));
+        if (!frame.titleBarHidden && titleRect.intersects(paintRect))
+        {
+            paintTitleBar(painter, frame, titleRect);
+            if (paintTitleBarContents)
+                paintTitleBarContents(painter, paintRect);
+        }
+
+        // Paint borders when no aplha is supported
+        if (frame.outline.isValid())
+        {
+            painter->save();
+            painter->setRenderHint(QPainter::Antialiasing, false);
+            painter->setBrush(Qt::NoBrush);
+            painter->setPen(frame.outline);
+            painter->drawRect(frame.rect.adjusted(0, 0, -1, -1));
+            painter->restore();
+        }
+
+        painter->restore();
+    }
+
+    void FramePainter::paintBorders(QPainter *painter, const Frame &frame, const QRect &paintRect)
+    {
+        // Only the border strips are visible, the client covers the rest of the frame
+        QRegion borders(frame.rect);
+        borders -= frame.rect - frame.borders;
+
+        // clip away the top part
+        if (!frame.titleBarHidden)
+            borders -= QRect(frame.rect.topLeft(), QSize(frame.rect.width(), frame.borders.top()));
+
+        borders &= paintRect;
+        if (borders.isEmpty())
+            return;
+
+        painter->save();
+        painter->setClipRegion(borders, Qt::IntersectClip);
+        painter->fillRect(paintRect, Qt::transparent);
+
+        // Only the corners are rasterized, the edges are plain fills
+        FrameCornerAtlas::self()->fillRoundedRect(painter, frame.rect, frame.radius, frame.color);
+
+        painter->restore();
+    }
+
+    void FramePainter::paintTitleBar(QPainter *painter, const Frame &frame, const QRect &titleRect)
+    {
+        // render a linear gradient on title area and draw a light border at the top,
+        // a flat title bar only has the light border
+        const TitleBarTileCache::Key key {
+            frame.color.rgba(), titleRect.height(), frame.radius, frame.intensity, painter->device()->devicePixelRatioF()
+        };
+
+        if (frame.roundedTitleBar)
+        {
+            // every corner is rounded, not worth caching
+            QLinearGradient gradient = TitleBarTileCache::gradient(key);
+            gradient.setStart(0, titleRect.top());
+            gradient.setFinalStop(0, titleRect.top() + key.height);
+
+            painter->save();
+            painter->setPen(Qt::NoPen);
+            painter->setBrush(gradient);
+            painter->drawRoundedRect(titleRect, frame.radius, frame.radius);
+            painter->restore();
+        }
+        else
+        {
+            const int radius = qMin(frame.radius, titleRect.width() / 2);
+            TitleBarTileCache::self()->fill(painter, titleRect, key, frame.roundedTopLeft ? radius : 0,
+                                            frame.roundedTopRight ? radius : 0);
+        }
+    }
+}
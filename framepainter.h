@@ -0,0 +1,78 @@
+#ifndef FRAME_PAINTER_H
+#define FRAME_PAINTER_H
+
+/*
+ * Copyright 2020  Alejandro Romero Rivera <k1r0d3v@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QColor>
+#include <QMargins>
+#include <QRect>
+
+#include <functional>
+
+class QPainter;
+
+
+namespace Breeze
+{
+    /**
+     * Paints the frame of a decoration clipped to a repaint rect: the border strips, the title bar
+     * background and, when no alpha channel is supported, the outline.
+     *
+     * Nothing outside the repaint rect is touched, the borders are only filled where they meet it and
+     * the title bar contents are only painted when the title bar does.
+     */
+    class FramePainter
+    {
+    public:
+        /**
+         * Paint the caption and the buttons, the painter is clipped to the repaint rect given
+         */
+        using PaintContents = std::function<void(QPainter *, const QRect &)>;
+
+        struct Frame
+        {
+            QRect rect;
+            QMargins borders; // The title bar is the top border
+            QColor color; // Title bar color, with its alpha
+            QColor outline; // Drawn around the frame when valid
+            int radius = 0; // Frame radius, 0 when no alpha channel is supported
+            int intensity = 0; // Title bar gradient intensity, 0 for a flat title bar
+            bool shaded = false; // Only the title bar is shown
+            bool titleBarHidden = false;
+            bool roundedTitleBar = false; // Every title bar corner is rounded, for a shaded window
+            bool roundedTopLeft = false; // Rounded top corners, square on the screen edges
+            bool roundedTopRight = false;
+        };
+
+        /**
+         * Paint the part of the frame in the repaint rect
+         */
+        static void paint(QPainter *painter, const Frame &frame, const QRect &repaintRect,
+                          const PaintContents &paintTitleBarContents);
+
+    private:
+        static void paintBorders(QPainter *painter, const Frame &frame, const QRect &paintRect);
+
+        static void paintTitleBar(QPainter *painter, const Frame &frame, const QRect &titleRect);
+    };
+}
+
+#endif
@@ -23,8 +23,19 @@
 
 // Qt
 #include <QPainter>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
 #include <QtMath>
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace Breeze
 {
 
@@ -101,75 +112,275 @@ static QVector<BoxLobes> computeLobes(int radius)
     };
 }
 
+// Number of rows, or columns, blurred at once.
+static const int BlurLanes = 16;
+
 /**
- * Process a row with a box filter.
+ * Process interleaved rows with a box filter.
  *
- * @param src The start of the row.
+ * Pixel i of lane j is at src[i * srcStep + j], respectively dst[i * dstStep + j].
+ * The first and the last pixels of a lane are repeated past its ends.
+ *
+ * @param src The start of the rows.
+ * @param srcStep The number of bytes from one pixel of a lane to the next one in src.
  * @param dst The destination.
- * @param width The width of the row, in pixels.
- * @param horizontalStride The number of bytes from one alpha value to the
- *    next alpha value.
- * @param verticalStride The number of bytes from one row to the next row.
+ * @param dstStep The number of bytes from one pixel of a lane to the next one in dst.
+ * @param width The width of the rows, in pixels.
+ * @param lanes The number of rows.
  * @param lobes Params of the box filter.
- * @param transposeInput Whether the input is transposed.
- * @param transposeOutput Whether the output should be transposed.
  **/
-static inline void boxBlurRowAlpha(const uint8_t *src, uint8_t *dst, int width, int horizontalStride,
-                                   int verticalStride, const BoxLobes &lobes, bool transposeInput,
-                                   bool transposeOutput)
+static inline void boxBlurLanesAlpha(const uint8_t *src, int srcStep, uint8_t *dst, int dstStep,
+                                     int width, int lanes, const BoxLobes &lobes)
+{
+    const int boxSize = lobes.left + 1 + lobes.right;
+    const int reciprocal = (1 << 24) / boxSize;
+    const int last = width - 1;
+
+    for (int lane = 0; lane < lanes; ++lane) {
+        const uint8_t *in = src + lane;
+        uint8_t *out = dst + lane;
+
+        uint32_t alphaSum = (boxSize + 1) / 2 + in[0] * lobes.left;
+        for (int i = 0; i <= lobes.right; ++i) {
+            alphaSum += in[qMin(i, last) * srcStep];
+        }
+
+        for (int i = 0; i < width; ++i) {
+            out[i * dstStep] = (alphaSum * reciprocal) >> 24;
+            alphaSum += in[qMin(i + lobes.right + 1, last) * srcStep] - in[qMax(i - lobes.left, 0) * srcStep];
+        }
+    }
+}
+
+#ifdef __SSE2__
+// Largest box whose sums of alpha values fit in 16 bits.
+static const int MaxSimdBoxSize = 256;
+
+/**
+ * Compute (sum * reciprocal) >> 24 for eight 16 bit sums, as boxBlurLanesAlpha() does.
+ *
+ * The reciprocal is split in its high bits and its low 8 bits, the result is the high
+ * word of sum * high plus the carry of adding (sum * low) >> 8 to its low word.
+ **/
+static inline __m128i scaleAlphaSums(__m128i sums, __m128i reciprocalHigh, __m128i reciprocalLow)
 {
-    const int inputStep = transposeInput ? verticalStride : horizontalStride;
-    const int outputStep = transposeOutput ? verticalStride : horizontalStride;
+    const __m128i productHigh = _mm_mulhi_epu16(sums, reciprocalHigh);
+    const __m128i productLow = _mm_mullo_epi16(sums, reciprocalHigh);
+    const __m128i remainder = _mm_or_si128(_mm_slli_epi16(_mm_mulhi_epu16(sums, reciprocalLow), 8),
+                                           _mm_srli_epi16(_mm_mullo_epi16(sums, reciprocalLow), 8));
+
+    // There is a carry when remainder > ~productLow, compared unsigned
+    const __m128i sign = _mm_set1_epi16(-0x8000);
+    const __m128i complement = _mm_xor_si128(productLow, _mm_set1_epi16(-1));
+    const __m128i carry = _mm_cmpgt_epi16(_mm_xor_si128(remainder, sign), _mm_xor_si128(complement, sign));
+    return _mm_sub_epi16(productHigh, carry);
+}
 
+/**
+ * SSE2 version of boxBlurLanesAlpha() for BlurLanes lanes, the rows must be at
+ * least as wide as the box and the box at most MaxSimdBoxSize pixels.
+ **/
+static inline void boxBlurLanesAlphaSSE2(const uint8_t *src, int srcStep, uint8_t *dst, int dstStep,
+                                         int width, const BoxLobes &lobes)
+{
     const int boxSize = lobes.left + 1 + lobes.right;
     const int reciprocal = (1 << 24) / boxSize;
+    const __m128i reciprocalHigh = _mm_set1_epi16(static_cast<short>(reciprocal >> 8));
+    const __m128i reciprocalLow = _mm_set1_epi16(static_cast<short>(reciprocal & 0xff));
+    const __m128i zero = _mm_setzero_si128();
 
-    uint32_t alphaSum = (boxSize + 1) / 2;
+    auto load = [src, srcStep](int i) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * srcStep));
+    };
 
-    const uint8_t *left = src;
-    const uint8_t *right = src;
-    uint8_t *out = dst;
+    // Sums of at most MaxSimdBoxSize alpha values, they fit unsigned 16 bit lanes
+    __m128i sumsLow = _mm_set1_epi16(static_cast<short>((boxSize + 1) / 2));
+    __m128i sumsHigh = sumsLow;
+    auto add = [&sumsLow, &sumsHigh, zero](__m128i added, __m128i removed) {
+        sumsLow = _mm_add_epi16(sumsLow, _mm_sub_epi16(_mm_unpacklo_epi8(added, zero), _mm_unpacklo_epi8(removed, zero)));
+        sumsHigh = _mm_add_epi16(sumsHigh, _mm_sub_epi16(_mm_unpackhi_epi8(added, zero), _mm_unpackhi_epi8(removed, zero)));
+    };
 
-    const uint8_t firstValue = src[0];
-    const uint8_t lastValue = src[(width - 1) * inputStep];
+    const __m128i firstValues = load(0);
+    const __m128i lastValues = load(width - 1);
+    for (int i = 0; i < lobes.left; ++i) {
+        add(firstValues, zero);
+    }
+    for (int i = 0; i <= lobes.right; ++i) {
+        add(load(i), zero);
+    }
 
-    alphaSum += firstValue * lobes.left;
+    auto step = [&](int i, __m128i added, __m128i removed) {
+        const __m128i low = scaleAlphaSums(sumsLow, reciprocalHigh, reciprocalLow);
+        const __m128i high = scaleAlphaSums(sumsHigh, reciprocalHigh, reciprocalLow);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * dstStep), _mm_packus_epi16(low, high));
+        add(added, removed);
+    };
 
-    const uint8_t *initEnd = src + (boxSize - lobes.left) * inputStep;
-    while (right < initEnd) {
-        alphaSum += *right;
-        right += inputStep;
+    // Split at the ends of the lanes instead of clamping the sampled pixels
+    int i = 0;
+    for (; i < lobes.left; ++i) {
+        step(i, load(i + lobes.right + 1), firstValues);
     }
+    for (; i < width - lobes.right - 1; ++i) {
+        step(i, load(i + lobes.right + 1), load(i - lobes.left));
+    }
+    for (; i < width; ++i) {
+        step(i, lastValues, load(i - lobes.left));
+    }
+}
+#endif
 
-    const uint8_t *leftEnd = src + boxSize * inputStep;
-    while (right < leftEnd) {
-        *out = (alphaSum * reciprocal) >> 24;
-        alphaSum += *right - firstValue;
-        right += inputStep;
-        out += outputStep;
+/**
+ * Process interleaved rows with a box filter, using SIMD when available.
+ *
+ * @see boxBlurLanesAlpha
+ **/
+static inline void boxBlurLanes(const uint8_t *src, int srcStep, uint8_t *dst, int dstStep,
+                                int width, int lanes, const BoxLobes &lobes)
+{
+#ifdef __SSE2__
+    const int boxSize = lobes.left + 1 + lobes.right;
+    if (lanes == BlurLanes && boxSize <= width && boxSize <= MaxSimdBoxSize) {
+        boxBlurLanesAlphaSSE2(src, srcStep, dst, dstStep, width, lobes);
+        return;
+    }
+#endif
+    boxBlurLanesAlpha(src, srcStep, dst, dstStep, width, lanes, lobes);
+}
+
+#ifdef __SSE2__
+/**
+ * Transpose a tile of 16x16 bytes.
+ **/
+static inline void transposeTile16(const uint8_t *src, int srcStride, uint8_t *dst, int dstStride)
+{
+    __m128i rows[16];
+    for (int i = 0; i < 16; ++i) {
+        rows[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * srcStride));
     }
 
-    const uint8_t *centerEnd = src + width * inputStep;
-    while (right < centerEnd) {
-        *out = (alphaSum * reciprocal) >> 24;
-        alphaSum += *right - *left;
-        left += inputStep;
-        right += inputStep;
-        out += outputStep;
+    // Four perfect shuffles of the rows give the transposed tile
+    for (int round = 0; round < 4; ++round) {
+        __m128i shuffled[16];
+        for (int i = 0; i < 8; ++i) {
+            shuffled[2 * i] = _mm_unpacklo_epi8(rows[i], rows[i + 8]);
+            shuffled[2 * i + 1] = _mm_unpackhi_epi8(rows[i], rows[i + 8]);
+        }
+        std::copy(shuffled, shuffled + 16, rows);
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * dstStride), rows[i]);
+    }
+}
+#endif
+
+/**
+ * Transpose a block of bytes, tile by tile when SIMD is available.
+ *
+ * @param src The start of the block.
+ * @param srcStride The number of bytes from one row to the next one in src.
+ * @param dst The destination.
+ * @param dstStride The number of bytes from one row to the next one in dst.
+ * @param rows The number of rows of the source block.
+ * @param columns The number of columns of the source block.
+ **/
+static inline void transposeAlpha(const uint8_t *src, int srcStride, uint8_t *dst, int dstStride,
+                                  int rows, int columns)
+{
+    int tiledRows = 0;
+    int tiledColumns = 0;
+
+#ifdef __SSE2__
+    tiledRows = rows - rows % 16;
+    tiledColumns = columns - columns % 16;
+    for (int i = 0; i < tiledRows; i += 16) {
+        for (int j = 0; j < tiledColumns; j += 16) {
+            transposeTile16(src + i * srcStride + j, srcStride, dst + j * dstStride + i, dstStride);
+        }
+    }
+#endif
+
+    for (int i = 0; i < rows; ++i) {
+        for (int j = i < tiledRows ? tiledColumns : 0; j < columns; ++j) {
+            dst[j * dstStride + i] = src[i * srcStride + j];
+        }
+    }
+}
+
+/**
+ * Copy the alpha values of a row of pixels into a packed row.
+ *
+ * @param src The alpha value of the first pixel.
+ * @param dst The destination.
+ * @param width The width of the row, in pixels.
+ * @param pixelStride The number of bytes from one alpha value to the next one.
+ **/
+static inline void extractAlphaRow(const uint8_t *src, uint8_t *dst, int width, int pixelStride)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    if (pixelStride == 4 && QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+        // The alpha value is the most significant byte of each pixel
+        const __m128i *pixels = reinterpret_cast<const __m128i *>(src - 3);
+        for (; i + 16 <= width; i += 16, pixels += 4) {
+            const __m128i low = _mm_packs_epi32(_mm_srli_epi32(_mm_loadu_si128(pixels), 24),
+                                                _mm_srli_epi32(_mm_loadu_si128(pixels + 1), 24));
+            const __m128i high = _mm_packs_epi32(_mm_srli_epi32(_mm_loadu_si128(pixels + 2), 24),
+                                                 _mm_srli_epi32(_mm_loadu_si128(pixels + 3), 24));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(low, high));
+        }
+    }
+#endif
+
+    for (; i < width; ++i) {
+        dst[i] = src[i * pixelStride];
+    }
+}
+
+/**
+ * Copy a packed row of alpha values into a row of pixels.
+ *
+ * @see extractAlphaRow
+ **/
+static inline void storeAlphaRow(const uint8_t *src, uint8_t *dst, int width, int pixelStride)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    if (pixelStride == 4 && QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i colorMask = _mm_set1_epi32(0x00ffffff);
+        __m128i *pixels = reinterpret_cast<__m128i *>(dst - 3);
+        for (; i + 16 <= width; i += 16, pixels += 4) {
+            const __m128i alpha = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            const __m128i low = _mm_unpacklo_epi8(zero, alpha);
+            const __m128i high = _mm_unpackhi_epi8(zero, alpha);
+            const __m128i alphas[4] = {
+                _mm_unpacklo_epi16(zero, low), _mm_unpackhi_epi16(zero, low),
+                _mm_unpacklo_epi16(zero, high), _mm_unpackhi_epi16(zero, high)
+            };
+            for (int j = 0; j < 4; ++j) {
+                const __m128i color = _mm_and_si128(_mm_loadu_si128(pixels + j), colorMask);
+                _mm_storeu_si128(pixels + j, _mm_or_si128(color, alphas[j]));
+            }
+        }
     }
+#endif
 
-    const uint8_t *rightEnd = dst + width * outputStep;
-    while (out < rightEnd) {
-        *out = (alphaSum * reciprocal) >> 24;
-        alphaSum += lastValue - *left;
-        left += inputStep;
-        out += outputStep;
+    for (; i < width; ++i) {
+        dst[i * pixelStride] = src[i];
     }
 }
 
 /**
  * Blur the alpha channel of a given image.
  *
+ * The alpha channel is blurred in a tightly packed 8 bit plane, BlurLanes rows
+ * or columns at once.
+ *
  * @param image The input image.
  * @param radius The blur radius.
  * @param rect Specifies what part of the image to blur. If nothing is provided, then
@@ -188,28 +399,156 @@ static inline void boxBlurAlpha(QImage &image, int radius, const QRect &rect = {
     const int alphaOffset = QSysInfo::ByteOrder == QSysInfo::BigEndian ? 0 : 3;
     const int width = blurRect.width();
     const int height = blurRect.height();
-    const int rowStride = image.bytesPerLine();
     const int pixelStride = image.depth() >> 3;
 
-    const int bufferStride = qMax(width, height) * pixelStride;
+    // Extract the alpha channel.
+    QVector<uint8_t> plane(width * height);
+    for (int i = 0; i < height; ++i) {
+        const uint8_t *row = image.constScanLine(blurRect.y() + i) + blurRect.x() * pixelStride + alphaOffset;
+        extractAlphaRow(row, plane.data() + i * width, width, pixelStride);
+    }
+
+    const int bufferStride = qMax(width, height) * BlurLanes;
     QScopedPointer<uint8_t, QScopedPointerArrayDeleter<uint8_t> > buf(new uint8_t[2 * bufferStride]);
     uint8_t *buf1 = buf.data();
     uint8_t *buf2 = buf1 + bufferStride;
 
-    // Blur the image in horizontal direction.
+    // Blur the image in horizontal direction, a band of interleaved rows at a time.
+    for (int i = 0; i < height; i += BlurLanes) {
+        const int lanes = qMin(BlurLanes, height - i);
+        uint8_t *band = plane.data() + i * width;
+
+        transposeAlpha(band, width, buf1, BlurLanes, lanes, width);
+
+        boxBlurLanes(buf1, BlurLanes, buf2, BlurLanes, width, lanes, lobes[0]);
+        boxBlurLanes(buf2, BlurLanes, buf1, BlurLanes, width, lanes, lobes[1]);
+        boxBlurLanes(buf1, BlurLanes, buf2, BlurLanes, width, lanes, lobes[2]);
+
+        transposeAlpha(buf2, BlurLanes, band, width, width, lanes);
+    }
+
+    // Blur the image in vertical direction, a block of columns at a time. Blocks of the
+    // plane already are their columns as interleaved rows, each one is gathered into
+    // the scratch buffers by the first filter and scattered back by the last one.
+    for (int i = 0; i < width; i += BlurLanes) {
+        const int lanes = qMin(BlurLanes, width - i);
+        uint8_t *block = plane.data() + i;
+
+        boxBlurLanes(block, width, buf1, BlurLanes, height, lanes, lobes[0]);
+        boxBlurLanes(buf1, BlurLanes, buf2, BlurLanes, height, lanes, lobes[1]);
+        boxBlurLanes(buf2, BlurLanes, block, width, height, lanes, lobes[2]);
+    }
+
+    // Write the blurred alpha channel back.
     for (int i = 0; i < height; ++i) {
         uint8_t *row = image.scanLine(blurRect.y() + i) + blurRect.x() * pixelStride + alphaOffset;
-        boxBlurRowAlpha(row, buf1, width, pixelStride, rowStride, lobes[0], false, false);
-        boxBlurRowAlpha(buf1, buf2, width, pixelStride, rowStride, lobes[1], false, false);
-        boxBlurRowAlpha(buf2, row, width, pixelStride, rowStride, lobes[2], false, false);
+        storeAlphaRow(plane.constData() + i * width, row, width, pixelStride);
     }
+}
+
+// Number of samples of the vertical integral of the analytic blur.
+static const int AnalyticSamples = 4;
+
+/**
+ * Approximate the error function, with a maximum error of 5e-4.
+ *
+ * See Abramowitz and Stegun, 7.1.27.
+ **/
+static inline float approximateErf(float x)
+{
+    const float a = qAbs(x);
+    float t = 1.0f + (0.278393f + (0.230389f + 0.078108f * a * a) * a) * a;
+    t *= t;
+    const float value = 1.0f - 1.0f / (t * t);
+    return x < 0 ? -value : value;
+}
 
-    // Blur the image in vertical direction.
-    for (int i = 0; i < width; ++i) {
-        uint8_t *column = image.scanLine(blurRect.y()) + (blurRect.x() + i) * pixelStride + alphaOffset;
-        boxBlurRowAlpha(column, buf1, height, pixelStride, rowStride, lobes[0], true, false);
-        boxBlurRowAlpha(buf1, buf2, height, pixelStride, rowStride, lobes[1], false, false);
-        boxBlurRowAlpha(buf2, column, height, pixelStride, rowStride, lobes[2], false, true);
+/**
+ * Compute the standard deviation of the three box filters of a blur radius.
+ *
+ * @param radius The blur radius.
+ **/
+static inline qreal calculateLobesStdDev(int radius)
+{
+    qreal variance = 0;
+    for (const BoxLobes &lobe : computeLobes(radius)) {
+        const int boxSize = lobe.left + 1 + lobe.right;
+        variance += (boxSize * boxSize - 1) / 12.0;
+    }
+    return qSqrt(variance);
+}
+
+/**
+ * Evaluate the alpha channel of a box with rounded corners blurred by a Gaussian.
+ *
+ * The blur is integrated in closed form horizontally and sampled vertically, see
+ * https://madebyevan.com/shaders/fast-rounded-rectangle-shadows/
+ * Rows away from the corners are the product of a per column and a per row term.
+ *
+ * @param image The output image, its pixels are set to black with the blurred alpha.
+ * @param box The box, in pixels.
+ * @param cornerRadius The radius of the box' corners, in pixels.
+ * @param stdDev The standard deviation of the Gaussian, in pixels.
+ * @param rect Specifies what part of the image to evaluate.
+ **/
+static inline void analyticBlurAlpha(QImage &image, const QRectF &box, qreal cornerRadius, qreal stdDev, const QRect &rect)
+{
+    const float sigma = stdDev;
+    const float halfWidth = box.width() * 0.5;
+    const float halfHeight = box.height() * 0.5;
+    const float corner = qMin<qreal>(cornerRadius, qMin(halfWidth, halfHeight));
+    const QPointF center = box.center();
+
+    const float erfScale = M_SQRT1_2 / sigma;
+    const float gaussianScale = 1.0 / (qSqrt(2.0 * M_PI) * sigma);
+
+    // Horizontal integral over the straight sides of the box.
+    QVector<float> columns(rect.width());
+    for (int j = 0; j < rect.width(); ++j) {
+        const float x = rect.x() + j + 0.5 - center.x();
+        columns[j] = 0.5f * (approximateErf((x + halfWidth) * erfScale) - approximateErf((x - halfWidth) * erfScale));
+    }
+
+    for (int i = 0; i < rect.height(); ++i) {
+        const float y = rect.y() + i + 0.5 - center.y();
+
+        // Sample the vertical integral over the box, within 3 sigma.
+        const float low = y - halfHeight;
+        const float high = y + halfHeight;
+        const float start = qBound(low, -3.0f * sigma, high);
+        const float end = qBound(low, 3.0f * sigma, high);
+        const float step = (end - start) / AnalyticSamples;
+
+        float weights[AnalyticSamples];
+        float halfWidths[AnalyticSamples];
+        float rowWeight = 0;
+        bool straight = true;
+        for (int k = 0; k < AnalyticSamples; ++k) {
+            const float sample = start + (k + 0.5f) * step;
+            weights[k] = gaussianScale * qExp(-sample * sample / (2.0f * sigma * sigma)) * step;
+            rowWeight += weights[k];
+
+            // How far the corner curve is from the straight side at this height.
+            const float delta = qMin(halfHeight - corner - qAbs(y - sample), 0.0f);
+            const float inset = corner - qSqrt(qMax(0.0f, corner * corner - delta * delta));
+            halfWidths[k] = halfWidth - inset;
+            straight = straight && inset == 0;
+        }
+
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(rect.y() + i)) + rect.x();
+        for (int j = 0; j < rect.width(); ++j) {
+            float value = 0;
+            if (straight) {
+                value = columns[j] * rowWeight;
+            } else {
+                const float x = rect.x() + j + 0.5 - center.x();
+                for (int k = 0; k < AnalyticSamples; ++k) {
+                    value += weights[k] * 0.5f * (approximateErf((x + halfWidths[k]) * erfScale)
+                                                  - approximateErf((x - halfWidths[k]) * erfScale));
+                }
+            }
+            line[j] = qRgba(0, 0, 0, qBound(0, qRound(value * 255), 255));
+        }
     }
 }
 
@@ -243,36 +582,51 @@ static inline void mirrorTopLeftQuadrant(QImage &image)
     }
 }
 
-static void renderShadow(QPainter *painter, const QRect &rect, qreal borderRadius, const QPoint &offset, int radius, const QColor &color)
+/**
+ * Render a shadow into an image of the size of the blurred box.
+ *
+ * @param shadow The output image, its size and device pixel ratio are already set.
+ * @param boxSize The size of the box.
+ * @param borderRadius The radius of box' corners.
+ * @param radius The blur radius.
+ * @param color The color of the shadow.
+ * @param engine How the blurred box is generated.
+ **/
+static void renderShadow(QImage &shadow, const QSize &boxSize, qreal borderRadius, int radius, const QColor &color,
+                         BoxShadowRenderer::Engine engine)
 {
-    const QSize inflation = calculateBlurExtent(radius);
-    const QSize size = rect.size() + 2 * inflation;
+    const QSize size = boxSize + 2 * calculateBlurExtent(radius);
+    const qreal dpr = shadow.devicePixelRatio();
 
-    const qreal dpr = painter->device()->devicePixelRatioF();
-
-    QImage shadow(size * dpr, QImage::Format_ARGB32_Premultiplied);
-    shadow.setDevicePixelRatio(dpr);
     shadow.fill(Qt::transparent);
 
-    QRect boxRect(QPoint(0, 0), rect.size());
+    QRect boxRect(QPoint(0, 0), boxSize);
     boxRect.moveCenter(QRect(QPoint(0, 0), size).center());
 
     const qreal xRadius = 2.0 * borderRadius / boxRect.width();
     const qreal yRadius = 2.0 * borderRadius / boxRect.height();
 
-    QPainter shadowPainter;
-    shadowPainter.begin(&shadow);
-    shadowPainter.setRenderHint(QPainter::Antialiasing);
-    shadowPainter.setPen(Qt::NoPen);
-    shadowPainter.setBrush(Qt::black);
-    shadowPainter.drawRoundedRect(boxRect, xRadius, yRadius);
-    shadowPainter.end();
-
     // Because the shadow texture is symmetrical, that's enough to blur
     // only the top-left quadrant and then mirror it.
     const QRect blurRect(0, 0, qCeil(shadow.width() * 0.5), qCeil(shadow.height() * 0.5));
     const int scaledRadius = qRound(radius * dpr);
-    boxBlurAlpha(shadow, scaledRadius, blurRect);
+
+    QPainter shadowPainter;
+    if (engine == BoxShadowRenderer::Engine::Analytic && scaledRadius >= 2) {
+        // The same box and corners as the rasterized ones, in device pixels.
+        const QRectF deviceBoxRect(QPointF(boxRect.topLeft()) * dpr, QSizeF(boxRect.size()) * dpr);
+        analyticBlurAlpha(shadow, deviceBoxRect, qMin(xRadius, yRadius) * dpr,
+                          calculateLobesStdDev(scaledRadius), blurRect);
+    } else {
+        shadowPainter.begin(&shadow);
+        shadowPainter.setRenderHint(QPainter::Antialiasing);
+        shadowPainter.setPen(Qt::NoPen);
+        shadowPainter.setBrush(Qt::black);
+        shadowPainter.drawRoundedRect(boxRect, xRadius, yRadius);
+        shadowPainter.end();
+
+        boxBlurAlpha(shadow, scaledRadius, blurRect);
+    }
     mirrorTopLeftQuadrant(shadow);
 
     // Give the shadow a tint of the desired color.
@@ -280,14 +634,44 @@ static void renderShadow(QPainter *painter, const QRect &rect, qreal borderRadiu
     shadowPainter.setCompositionMode(QPainter::CompositionMode_SourceIn);
     shadowPainter.fillRect(shadow.rect(), color);
     shadowPainter.end();
-
-    // Actually, present the shadow.
-    QRect shadowRect = shadow.rect();
-    shadowRect.setSize(shadowRect.size() / dpr);
-    shadowRect.moveCenter(rect.center() + offset);
-    painter->drawImage(shadowRect, shadow);
 }
 
+/**
+ * Render one shadow on a thread of the pool.
+ **/
+class ShadowRenderTask : public QRunnable
+{
+public:
+    ShadowRenderTask(QImage &shadow, const QSize &boxSize, qreal borderRadius, int radius, const QColor &color,
+                     BoxShadowRenderer::Engine engine, QSemaphore &finished)
+        : m_shadow(shadow)
+        , m_boxSize(boxSize)
+        , m_borderRadius(borderRadius)
+        , m_radius(radius)
+        , m_color(color)
+        , m_engine(engine)
+        , m_finished(finished)
+    {
+        // Owned by render(), which waits for it.
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        renderShadow(m_shadow, m_boxSize, m_borderRadius, m_radius, m_color, m_engine);
+        m_finished.release();
+    }
+
+private:
+    QImage &m_shadow;
+    const QSize m_boxSize;
+    const qreal m_borderRadius;
+    const int m_radius;
+    const QColor m_color;
+    const BoxShadowRenderer::Engine m_engine;
+    QSemaphore &m_finished;
+};
+
 void BoxShadowRenderer::setBoxSize(const QSize &size)
 {
     m_boxSize = size;
@@ -303,6 +687,11 @@ void BoxShadowRenderer::setDevicePixelRatio(qreal dpr)
     m_dpr = dpr;
 }
 
+void BoxShadowRenderer::setEngine(Engine engine)
+{
+    m_engine = engine;
+}
+
 void BoxShadowRenderer::addShadow(const QPoint &offset, int radius, const QColor &color)
 {
     Shadow shadow = {};
@@ -331,9 +720,39 @@ QImage BoxShadowRenderer::render() const
     QRect boxRect(QPoint(0, 0), m_boxSize);
     boxRect.moveCenter(QRect(QPoint(0, 0), canvasSize).center());
 
-    QPainter painter(&canvas);
+    // Allocate the image of every shadow up front, each one is rendered on its own.
+    QVector<QImage> shadows;
+    shadows.reserve(m_shadows.size());
     for (const Shadow &shadow : qAsConst(m_shadows)) {
-        renderShadow(&painter, boxRect, m_borderRadius, shadow.offset, shadow.radius, shadow.color);
+        const QSize size = m_boxSize + 2 * calculateBlurExtent(shadow.radius);
+        shadows.append(QImage(size * m_dpr, QImage::Format_ARGB32_Premultiplied));
+        shadows.last().setDevicePixelRatio(m_dpr);
+    }
+
+    // Render the shadows concurrently, the calling thread takes the first one and
+    // every one the pool has no free thread for.
+    QSemaphore finished;
+    std::vector<std::unique_ptr<ShadowRenderTask>> tasks;
+    for (int i = 1; i < m_shadows.size(); ++i) {
+        const Shadow &shadow = m_shadows.at(i);
+        tasks.emplace_back(new ShadowRenderTask(shadows[i], m_boxSize, m_borderRadius, shadow.radius,
+                                                shadow.color, m_engine, finished));
+        if (!QThreadPool::globalInstance()->tryStart(tasks.back().get())) {
+            tasks.back()->run();
+        }
+    }
+
+    const Shadow &first = m_shadows.first();
+    renderShadow(shadows.first(), m_boxSize, m_borderRadius, first.radius, first.color, m_engine);
+    finished.acquire(static_cast<int>(tasks.size()));
+
+    // Composite in the order the shadows were added, independently of the scheduling.
+    QPainter painter(&canvas);
+    for (int i = 0; i < m_shadows.size(); ++i) {
+        QRect shadowRect = shadows.at(i).rect();
+        shadowRect.setSize(shadowRect.size() / m_dpr);
+        shadowRect.moveCenter(boxRect.center() + m_shadows.at(i).offset);
+        painter.drawImage(shadowRect, shadows.at(i));
     }
     painter.end();
 
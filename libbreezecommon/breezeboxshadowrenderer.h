@@ -33,6 +33,14 @@ namespace Breeze
 class BREEZECOMMON_EXPORT BoxShadowRenderer
 {
 public:
+    /**
+     * How the blurred box of a shadow is generated.
+     **/
+    enum class Engine {
+        BoxBlur,  ///< Rasterize the box and blur it with three box filters.
+        Analytic  ///< Evaluate the box blurred by a Gaussian in closed form.
+    };
+
     // Compiler generated constructors & destructor are fine.
 
     /**
@@ -53,6 +61,12 @@ public:
      **/
     void setDevicePixelRatio(qreal dpr);
 
+    /**
+     * Set the engine generating the shadows.
+     * @param engine The engine, BoxBlur by default.
+     **/
+    void setEngine(Engine engine);
+
     /**
      * Add a shadow.
      * @param offset The offset of the shadow.
@@ -92,6 +106,7 @@ private:
     QSize m_boxSize;
     qreal m_borderRadius = 0.0;
     qreal m_dpr = 1.0;
+    Engine m_engine = Engine::BoxBlur;
 
     struct Shadow {
         QPoint offset;
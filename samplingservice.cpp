@@ -0,0 +1,99 @@
+#include "config-breeze.h"
+#include "samplingservice.h"
+#include "clientutil.h"
+
+#if BREEZE_HAVE_X11
+#include <QX11Info>
+
+#include <X11/Xlib.h>
+#include <xcb/xcb.h>
+#endif
+
+
+namespace
+{
+    const int g_replyPollInterval = 4;
+}
+
+SamplingService *SamplingService::self()
+{
+    static SamplingService s_self;
+    return &s_self;
+}
+
+SamplingService::SamplingService()
+{
+    m_sendTimer.setSingleShot(true);
+    m_sendTimer.setInterval(0);
+    QObject::connect(&m_sendTimer, &QTimer::timeout, &m_sendTimer, [this]() { sendQueued(); });
+
+    m_pollTimer.setInterval(g_replyPollInterval);
+    QObject::connect(&m_pollTimer, &QTimer::timeout, &m_pollTimer, [this]() { pollSent(); });
+}
+
+void SamplingService::enqueue(ClientUtil *client)
+{
+    m_queued.append(client);
+
+    // Wait for the other clients to queue their requests in this event loop pass
+    if (!m_sendTimer.isActive())
+        m_sendTimer.start();
+}
+
+void SamplingService::cancel(ClientUtil *client)
+{
+    m_queued.removeAll(client);
+    m_sent.removeAll(client);
+
+    if (m_sent.isEmpty())
+        m_pollTimer.stop();
+}
+
+void SamplingService::sendQueued()
+{
+#if BREEZE_HAVE_X11
+    const auto queued = std::move(m_queued);
+    m_queued.clear();
+
+    // Queue all the composites, the clients failing to render are already finished
+    QVector<ClientUtil *> rendered;
+    rendered.reserve(queued.size());
+    for (auto client : queued)
+    {
+        if (client->beginPendingRequest())
+            rendered.append(client);
+    }
+
+    if (rendered.isEmpty())
+        return;
+
+    // Hand the queued Xlib requests to xcb, so the composites are done before our reads
+    XFlush(QX11Info::display());
+
+    // Pipeline all the image reads behind the composites
+    for (auto client : qAsConst(rendered))
+        client->sendPendingRequest();
+
+    xcb_flush(QX11Info::connection());
+
+    m_sent += rendered;
+    if (!m_pollTimer.isActive())
+        m_pollTimer.start();
+#endif
+}
+
+void SamplingService::pollSent()
+{
+    // The replies arrive in order, the first pending one blocks the rest
+    int i = 0;
+    while (i < m_sent.size())
+    {
+        if (!m_sent.at(i)->pollPendingRequest())
+            break;
+        ++i;
+    }
+    m_sent.remove(0, i);
+
+    if (m_sent.isEmpty())
+        m_pollTimer.stop();
+}
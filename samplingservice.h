@@ -0,0 +1,67 @@
+#ifndef SAMPLING_SERVICE_H
+#define SAMPLING_SERVICE_H
+
+/*
+ * Copyright 2020  Alejandro Romero Rivera <k1r0d3v@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QTimer>
+#include <QVector>
+
+class ClientUtil;
+
+/**
+ * Process wide batcher of the ClientUtil asynchronous requests.
+ *
+ * The requests made during an event loop pass are sent together: all the composites first and then all
+ * the image reads, with a single flush. The replies of every client are polled from the same timer,
+ * so the cost of a sampling round depends on the server latency instead of on the number of windows.
+ */
+class SamplingService
+{
+public:
+    /**
+     * @return The service instance
+     */
+    static SamplingService *self();
+
+    /**
+     * Queue the pending request of the client, it is sent on the next event loop pass
+     */
+    void enqueue(ClientUtil *client);
+
+    /**
+     * Forget the client request, it must be called before the client is destroyed
+     */
+    void cancel(ClientUtil *client);
+
+private:
+    SamplingService();
+
+    void sendQueued();
+
+    void pollSent();
+
+    QVector<ClientUtil *> m_queued; // Waiting to be sent
+    QVector<ClientUtil *> m_sent; // Waiting for the reply
+    QTimer m_sendTimer;
+    QTimer m_pollTimer;
+};
+
+#endif
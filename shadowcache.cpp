@@ -0,0 +1,54 @@
+#include "shadowcache.h"
+
+
+namespace Breeze
+{
+    namespace
+    {
+        // A few exceptions with their own shadow, each on a few screen scales
+        const int g_maxShadows = 16;
+    }
+
+    ShadowCache *ShadowCache::self()
+    {
+        static ShadowCache s_self;
+        return &s_self;
+    }
+
+    ShadowCache::ShadowCache()
+        : m_cache(g_maxShadows)
+    {
+    }
+
+    bool ShadowCache::lookup(const Key &key, ShadowPtr &shadow)
+    {
+        auto cached = m_cache.object(key);
+        if (cached == nullptr)
+        {
+            m_misses++;
+            return false;
+        }
+
+        m_hits++;
+        shadow = *cached;
+        return true;
+    }
+
+    void ShadowCache::insert(const Key &key, const ShadowPtr &shadow)
+    {
+        m_cache.insert(key, new ShadowPtr(shadow));
+    }
+
+    void ShadowCache::clear()
+    {
+        m_cache.clear();
+    }
+
+    uint qHash(const ShadowCache::Key &key, uint seed)
+    {
+        uint hash = ::qHash(key.size << 16 | key.frameRadius, seed);
+        hash = hash * 31 + ::qHash(key.strength, seed);
+        hash = hash * 31 + ::qHash(key.color, seed);
+        return hash * 31 + ::qHash(key.devicePixelRatio, seed);
+    }
+}
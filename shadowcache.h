@@ -0,0 +1,106 @@
+#ifndef SHADOW_CACHE_H
+#define SHADOW_CACHE_H
+
+/*
+ * Copyright 2020  Alejandro Romero Rivera <k1r0d3v@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <KDecoration2/DecorationShadow>
+
+#include <QCache>
+#include <QColor>
+#include <QSharedPointer>
+
+
+namespace Breeze
+{
+    /**
+     * Process wide least recently used cache of the decoration shadows.
+     * Decorations keep their shadow alive after it is evicted, eviction only forgets it.
+     */
+    class ShadowCache
+    {
+    public:
+        using ShadowPtr = QSharedPointer<KDecoration2::DecorationShadow>;
+
+        struct Key
+        {
+            int size; // InternalSettings::EnumShadowSize
+            int strength;
+            QRgb color;
+            int frameRadius;
+            qreal devicePixelRatio;
+
+            bool operator==(const Key &other) const
+            {
+                return size == other.size && strength == other.strength && color == other.color
+                    && frameRadius == other.frameRadius && devicePixelRatio == other.devicePixelRatio;
+            }
+        };
+
+        /**
+         * @return The cache instance
+         */
+        static ShadowCache *self();
+
+        /**
+         * Find the shadow of the key, it may be a null shadow when the key has none
+         *
+         * @return False when the key is not cached
+         */
+        bool lookup(const Key &key, ShadowPtr &shadow);
+
+        /**
+         * Cache the shadow of the key, a null shadow is cached too
+         */
+        void insert(const Key &key, const ShadowPtr &shadow);
+
+        /**
+         * Drop every shadow, e.g. when the last decoration is gone
+         */
+        void clear();
+
+        /**
+         * @return The number of lookups which found the key
+         */
+        quint64 hits() const
+        {
+            return m_hits;
+        }
+
+        /**
+         * @return The number of lookups which did not find the key
+         */
+        quint64 misses() const
+        {
+            return m_misses;
+        }
+
+    private:
+        ShadowCache();
+
+        QCache<Key, ShadowPtr> m_cache;
+        quint64 m_hits = 0;
+        quint64 m_misses = 0;
+    };
+
+    uint qHash(const ShadowCache::Key &key, uint seed = 0);
+}
+
+#endif
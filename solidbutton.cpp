@@ -22,39 +22,31 @@
 #include "solidbuttontheme.h"
 #include "breezedecoration.h"
 #include "util.h"
+#include "buttonrendercache.h"
+#include "animationdriver.h"
 
 #include <KDecoration2/Decoration>
 #include <KDecoration2/DecorationSettings>
 
 #include <QPainter>
-#include <QVariantAnimation>
 #include <QPainterPath>
-
-#define this_decoration (qobject_cast<Breeze::Decoration*>(this->decoration()))
+#include <QtMath>
+#include <QTimer>
 
 namespace Breeze
 {
     SolidButton::SolidButton(KDecoration2::DecorationButtonType type, KDecoration2::Decoration* decoration, QObject* parent)
         : ButtonBase(type, decoration, parent)
-        , m_animation(new QVariantAnimation(this))
+        , m_decoration(qobject_cast<Breeze::Decoration*>(decoration))
     {
-        if (this_decoration == nullptr)
+        if (m_decoration == nullptr)
         {
             qDebug("SolidButton: Decoration error: Expected a solid button decoration, exiting");
             exit(-1);
         }
 
-        // It is important start and end value are of the same type,
-        // hence 0.0 and not just 0 because the QVariant value
-        m_animation->setStartValue(0.0);
-        m_animation->setEndValue(1.0);
-        m_animation->setEasingCurve(QEasingCurve::InOutQuad);
-        connect(m_animation.data(), &QVariantAnimation::valueChanged, this, [this](const QVariant &value) {
-            setOpacity(value.toReal());
-        });
-
         // Setup default geometry
-        const int height = this_decoration->getButtonHeight();
+        const int height = m_decoration->getButtonHeight();
         KDecoration2::DecorationButton::setGeometry(QRect(0, 0, height, height));
         m_iconSize = QSize(height, height);
 
@@ -80,6 +72,12 @@ namespace Breeze
         reconfigure();
     }
 
+    SolidButton::~SolidButton()
+    {
+        if (m_animation != -1)
+            AnimationDriver::self()->release(m_animation);
+    }
+
     SolidButton::SolidButton(QObject *parent, const QVariantList &args)
         : SolidButton(args.at(0).value<KDecoration2::DecorationButtonType>(),
                  args.at(1).value<KDecoration2::Decoration*>(),
@@ -110,14 +108,50 @@ namespace Breeze
         if(!m_iconSize.isValid())
             m_iconSize = geometry().size().toSize();
 
+        painter->translate(geometry().topLeft());
+
+        // Steady state and already seen animation steps are a single blit
+        if (isCacheable())
+        {
+            const qreal devicePixelRatio = painter->device()->devicePixelRatioF();
+            const auto state = getState();
+
+            uint flags = 0;
+            flags |= state.isActive ? 1 << 0 : 0;
+            flags |= state.isChecked ? 1 << 1 : 0;
+            flags |= state.isPressed ? 1 << 2 : 0;
+            flags |= state.isHovered ? 1 << 3 : 0;
+            flags |= state.isBeingAnimated ? 1 << 4 : 0;
+            flags |= m_theme->showBackground(state) ? 1 << 5 : 0;
+            flags |= m_theme->showBorder(state) ? 1 << 6 : 0;
+            flags |= m_theme->showSymbol(state) ? 1 << 7 : 0;
+
+            const ButtonRenderCache::Key key {
+                static_cast<int>(type()), m_iconSize.width(), static_cast<int>(size().width()),
+                qRound(animationValue() * AnimationSteps), flags,
+                m_theme->backgroundColor(state).color().rgba(), m_theme->borderColor(state).color().rgba(),
+                m_theme->symbolColor(state).color().rgba(),
+                type() == KDecoration2::DecorationButtonType::Menu ? state.iconCacheKey : 0, devicePixelRatio
+            };
+
+            QImage image = ButtonRenderCache::self()->find(key);
+            if (image.isNull())
+            {
+                image = render(devicePixelRatio);
+                ButtonRenderCache::self()->insert(key, image);
+            }
+
+            painter->drawImage(QPointF(0, 0), image);
+            painter->restore();
+            return;
+        }
+
         // Prepare for painting
         painter->setRenderHints(QPainter::Antialiasing);
 
         // Scale painter so that its window matches QRect(-1, -1, 20, 20)
         // this makes all further rendering and scaling simpler
         // all further rendering is expected to be preformed inside QRect(0, 0, 18, 18)
-        painter->translate(geometry().topLeft());
-
         const qreal width = m_iconSize.width();
         painter->scale(width/20, width/20);
         painter->translate(1, 1);
@@ -129,15 +163,39 @@ namespace Breeze
         painter->restore();
     }
 
+    QImage SolidButton::render(qreal devicePixelRatio)
+    {
+        const qreal width = m_iconSize.width();
+        const int pixels = qCeil(width * devicePixelRatio);
+
+        QImage image(pixels, pixels, QImage::Format_ARGB32_Premultiplied);
+        image.setDevicePixelRatio(devicePixelRatio);
+        image.fill(Qt::transparent);
+
+        // Same transformation paint uses, relative to the button top left
+        QPainter painter(&image);
+        painter.setRenderHints(QPainter::Antialiasing);
+        painter.scale(width/20, width/20);
+        painter.translate(1, 1);
+        painter.setBrush(Qt::NoBrush);
+        painter.setPen(Qt::NoPen);
+
+        this->draw(&painter);
+        return image;
+    }
+
     void SolidButton::draw(QPainter *painter)
     {
         auto state = getState();
         auto center = QPointF(static_cast<qreal>(9), static_cast<qreal>(9));
         auto radius = static_cast<qreal>(7);
         if (!isPressed())
-            radius += (state.isChecked ? 1 :  1.5) * m_animation->currentValue().toReal();
+            radius += (state.isChecked ? 1 :  1.5) * animationValue();
+
+        const bool showBorder = m_theme->showBorder(state);
+        const bool showBackground = m_theme->showBackground(state);
 
-        if (m_theme->showBorder(state))
+        if (showBorder)
         {
             auto pen = QPen(m_theme->borderColor(state).color());
             pen.setJoinStyle(Qt::MiterJoin);
@@ -145,10 +203,10 @@ namespace Breeze
             painter->setPen(pen);
         }
 
-        if (m_theme->showBackground(state))
+        if (showBackground)
             painter->setBrush(m_theme->backgroundColor(state));
 
-        if (m_theme->showBackground(state) || m_theme->showBorder(state))
+        if (showBackground || showBorder)
             painter->drawEllipse(center, radius, radius);
 
         if (m_theme->showSymbol(state))
@@ -163,7 +221,7 @@ namespace Breeze
     void SolidButton::drawSymbol(QPainter *painter)
     {
         auto state = getState();
-        auto radius = 1.5 + static_cast<qreal>(1.5) * m_animation->currentValue().toReal();
+        auto radius = 1.5 + static_cast<qreal>(1.5) * animationValue();
 
         painter->setBrush(m_theme->symbolColor(state));
         painter->drawEllipse(QPointF(9, 9), radius, radius);
@@ -171,38 +229,66 @@ namespace Breeze
 
     void SolidButton::reconfigure()
     {
-        auto settings = this_decoration->internalSettings();
-        m_animation->setDuration(settings->animationsDuration());
+        if (m_animation != -1)
+            AnimationDriver::self()->setDuration(m_animation, m_decoration->internalSettings()->animationsDuration());
     }
 
     void SolidButton::updateAnimationState(bool forward)
     {
-        if(!this_decoration->internalSettings()->animationsEnabled())
+        if(!m_decoration->internalSettings()->animationsEnabled())
             return;
 
-        QAbstractAnimation::Direction dir = forward ? QAbstractAnimation::Forward : QAbstractAnimation::Backward;
-        if(m_animation->state() == QAbstractAnimation::Running && m_animation->direction() != dir)
-            m_animation->stop();
-        m_animation->setDirection(dir);
-
-        if(m_animation->state() != QAbstractAnimation::Running)
+        // Idle buttons hold no transition, it is created on the first hover
+        if (m_animation == -1)
         {
-            if ((forward && m_animation->currentValue().toReal() != 1.0) ||
-                (!forward && m_animation->currentValue().toReal() != 0.0))
-                m_animation->start();
+            if (!forward)
+                return;
+
+            // The driver repaints the button area once per frame while it moves
+            m_animation = AnimationDriver::self()->acquire(decoration(), [this](qreal value) {
+                m_opacity = value;
+
+                // Settled back at rest, give the transition back once the driver is done with it
+                if (value == 0 && !AnimationDriver::self()->isRunning(m_animation))
+                    QTimer::singleShot(0, this, &SolidButton::releaseAnimation);
+
+                return QRegion(geometry().toAlignedRect());
+            });
+            AnimationDriver::self()->setDuration(m_animation, m_decoration->internalSettings()->animationsDuration());
         }
+
+        // A running transition reverses from its current value
+        AnimationDriver::self()->start(m_animation, forward);
+    }
+
+    void SolidButton::releaseAnimation()
+    {
+        // It may have been started again meanwhile
+        if (m_animation == -1 || AnimationDriver::self()->isRunning(m_animation) || AnimationDriver::self()->value(m_animation) != 0)
+            return;
+
+        AnimationDriver::self()->release(m_animation);
+        m_animation = -1;
+    }
+
+    qreal SolidButton::animationValue() const
+    {
+        return qRound(AnimationDriver::self()->value(m_animation) * AnimationSteps) / static_cast<qreal>(AnimationSteps);
     }
 
     SolidButtonStateInfo SolidButton::getState() const
     {
+        // Read by reference, the decoration refreshes it once per frame
+        const auto &decorationState = m_decoration->state();
+
         SolidButtonStateInfo state;
-        state.isActive = this_decoration->client().toStrongRef()->isActive();
+        state.isActive = decorationState.isActive;
         state.isChecked = isChecked();
         state.isPressed = isPressed();
         state.isHovered = isHovered();
-        state.isBeingAnimated = m_animation->state() == QAbstractAnimation::Running;
-        state.titleBarColor = this_decoration->getTitleBarColor();
-        state.icon = decoration()->client().toStrongRef()->icon();
+        state.isBeingAnimated = AnimationDriver::self()->isRunning(m_animation);
+        state.titleBarColor = decorationState.titleBarColor;
+        state.iconCacheKey = decorationState.iconCacheKey;
         return state;
     }
 }
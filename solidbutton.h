@@ -33,10 +33,9 @@
 #include <utility>
 
 
-class QVariantAnimation;
-
 namespace Breeze
 {
+    class Decoration;
     class SolidButtonTheme;
     class SolidButton : public Breeze::ButtonBase
     {
@@ -56,7 +55,7 @@ namespace Breeze
         /**
          * Default destructor
          */
-        ~SolidButton() override = default;
+        ~SolidButton() override;
 
         /**
          * Set the button flag
@@ -109,18 +108,6 @@ namespace Breeze
             m_iconSize = value;
         }
 
-        /**
-         * Set the button opacity. Active state change animation.
-         *
-         * @param value Opacity in range [0, 1]
-         */
-        void setOpacity(qreal value)
-        {
-            if( m_opacity == value ) return;
-            m_opacity = value;
-            update();
-        }
-
         /**
          * @return The button opacity
          */
@@ -159,6 +146,11 @@ namespace Breeze
         }
 
     protected:
+        /**
+         * Number of steps of the animation value, renders are cached for each step
+         */
+        static constexpr int AnimationSteps = 32;
+
         /**
          * Invoked for painting the button inside a QRect(0, 0, 18, 18)
          *
@@ -173,6 +165,15 @@ namespace Breeze
          */
         virtual void drawSymbol(QPainter *painter);
 
+        /**
+         * @return False when the button can not be drawn from the render cache,
+         * e.g. when it draws something not described by its state
+         */
+        virtual bool isCacheable() const
+        {
+            return true;
+        }
+
     private Q_SLOTS:
         /**
          * Apply configuration changes
@@ -184,24 +185,41 @@ namespace Breeze
          */
         void updateAnimationState(bool);
 
+        /**
+         * Release the hover transition once it is back at rest
+         */
+        void releaseAnimation();
+
+    private:
+        /**
+         * Render the button into a new image of the icon size
+         */
+        QImage render(qreal devicePixelRatio);
+
     protected:
         /**
-         * @return The button animation
+         * @return The current animation value, quantized to AnimationSteps
          */
-        QSharedPointer<const QVariantAnimation> animation() const
-        {
-            return m_animation;
-        }
+        qreal animationValue() const;
 
         /**
          * @return The current button state info
          */
         SolidButtonStateInfo getState() const;
 
+        /**
+         * @return The decoration of the button, it outlives the button
+         */
+        Decoration *breezeDecoration() const
+        {
+            return m_decoration;
+        }
+
     private:
+        Decoration *m_decoration;
         ButtonFlag m_flag = ButtonFlag::FlagNone;
         QSharedPointer<SolidButtonTheme> m_theme;
-        QSharedPointer<QVariantAnimation> m_animation; // Active state change animation
+        int m_animation = -1; // Hover transition handle, see AnimationDriver, -1 while idle
         QPointF m_offset; // Vertical and Horizontal offset (for rendering)
         QSize m_iconSize;
         qreal m_opacity = 0;
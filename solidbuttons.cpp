@@ -1,10 +1,10 @@
 #include <QPainter>
-#include <QVariantAnimation>
 #include <QPainterPath>
 #include <QPalette>
 #include <KIconThemes/KIconLoader>
 #include <KIconThemes/KIconTheme>
 
+#include "breezedecoration.h"
 #include "solidbutton.h"
 #include "solidbuttons.h"
 #include "solidbuttontheme.h"
@@ -54,7 +54,7 @@ void Breeze::CloseButton::drawSymbol(QPainter *painter)
     symbolPen.setWidthF(1.7 * qMax(static_cast<qreal>(1.0), 20 / this->size().width()));
 
     auto scale = [this](QPointF q, QPointF v) {
-        auto animationValue = this->animation()->currentValue().toReal();
+        auto animationValue = this->animationValue();
         return QPointF((q.x() + v.x()) - v.x() * animationValue, (q.y() + v.y()) - v.y() * animationValue);
     };
 
@@ -115,7 +115,7 @@ void Breeze::MinimizeButton::drawSymbol(QPainter *painter)
     auto color = theme->symbolColor(state).color();
 
     auto scale = [this](QPointF q, QPointF v) {
-        auto animationValue = this->animation()->currentValue().toReal();
+        auto animationValue = this->animationValue();
         return QPointF((q.x() + v.x()) - v.x() * animationValue, (q.y() + v.y()) - v.y() * animationValue);
     };
 
@@ -141,7 +141,7 @@ void Breeze::KeepAboveButton::drawSymbol(QPainter *painter)
     auto color = theme->symbolColor(state).color();
 
     auto scale = [this](QPointF q, QPointF v) {
-        auto animationValue = this->animation()->currentValue().toReal();
+        auto animationValue = this->animationValue();
         return QPointF((q.x() + v.x()) - v.x() * animationValue, (q.y() + v.y()) - v.y() * animationValue);
     };
 
@@ -234,7 +234,7 @@ void Breeze::MenuButton::drawSymbol(QPainter *painter)
     palette.setColor(QPalette::Foreground, iconColor);
     KIconLoader::global()->setCustomPalette(palette);
 
-    state.icon.paint(painter, iconRect);
+    breezeDecoration()->state().icon.paint(painter, iconRect);
     if (activePalette == QPalette())
         KIconLoader::global()->resetPalette();
     else
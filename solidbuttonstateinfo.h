@@ -22,7 +22,6 @@
  */
 
 #include <QColor>
-#include <QIcon>
 
 struct SolidButtonStateInfo
 {
@@ -32,7 +31,7 @@ struct SolidButtonStateInfo
     bool isHovered = false;
     bool isBeingAnimated = false;
     QColor titleBarColor = {};
-    QIcon icon = {};
+    qint64 iconCacheKey = 0; // The icon itself is in the decoration state
 };
 
 #endif
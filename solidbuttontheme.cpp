@@ -49,7 +49,7 @@ namespace Breeze
 
     }
 
-    QBrush DefaultSolidButtonTheme::backgroundColor(SolidButtonStateInfo state) const
+    QColor DefaultSolidButtonTheme::computeBackgroundColor(const SolidButtonStateInfo &state) const
     {
         bool active = state.isActive || state.isHovered || state.isPressed || state.isBeingAnimated;
         auto titleBarLuminance = perceptiveLuminance(state.titleBarColor);
@@ -88,19 +88,62 @@ namespace Breeze
         }
     }
 
+    DefaultSolidButtonTheme::StateColors &DefaultSolidButtonTheme::stateColors(const SolidButtonStateInfo &state) const
+    {
+        if (state.titleBarColor != m_stateColorsTitleBarColor)
+        {
+            ++m_stateColorsGeneration;
+            m_stateColorsTitleBarColor = state.titleBarColor;
+        }
+
+        const int index = (state.isActive ? 1 : 0) | (state.isHovered ? 2 : 0) | (state.isPressed ? 4 : 0)
+            | (state.isChecked ? 8 : 0) | (state.isBeingAnimated ? 16 : 0);
+
+        auto &colors = m_stateColors[index];
+        if (colors.generation != m_stateColorsGeneration)
+        {
+            colors = StateColors();
+            colors.generation = m_stateColorsGeneration;
+        }
+
+        return colors;
+    }
+
+    QBrush DefaultSolidButtonTheme::backgroundColor(SolidButtonStateInfo state) const
+    {
+        auto &colors = stateColors(state);
+        if (colors.background.style() == Qt::NoBrush)
+            colors.background = computeBackgroundColor(state);
+
+        return colors.background;
+    }
+
     QBrush DefaultSolidButtonTheme::borderColor(SolidButtonStateInfo state) const
     {
-        auto color = backgroundColor(state).color();
-        auto titleBarLuminance = perceptiveLuminance(state.titleBarColor);
+        auto &colors = stateColors(state);
+        if (colors.border.style() == Qt::NoBrush)
+        {
+            // Derived from the background a subclass may override
+            const QColor background = backgroundColor(state).color();
+            const auto titleBarLuminance = perceptiveLuminance(state.titleBarColor);
+            colors.border = titleBarLuminance > 0.5 ? background.darker(130) : background.lighter(130);
+        }
 
-        return titleBarLuminance > 0.5 ? color.darker(130) : color.lighter(130);
+        return colors.border;
     }
 
     QBrush DefaultSolidButtonTheme::symbolColor(SolidButtonStateInfo state) const
     {
-        if (!state.isActive && !state.isHovered && !state.isPressed && !state.isBeingAnimated)
-            return backgroundColor(state).color().lighter(150);
-        return state.titleBarColor;
+        auto &colors = stateColors(state);
+        if (colors.symbol.style() == Qt::NoBrush)
+        {
+            if (!state.isActive && !state.isHovered && !state.isPressed && !state.isBeingAnimated)
+                colors.symbol = backgroundColor(state).color().lighter(150);
+            else
+                colors.symbol = state.titleBarColor;
+        }
+
+        return colors.symbol;
     }
 
     bool DefaultSolidButtonTheme::showBackground(SolidButtonStateInfo state) const
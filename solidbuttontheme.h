@@ -23,6 +23,8 @@
 
 #include "solidbuttonstateinfo.h"
 
+#include <array>
+
 
 namespace Breeze
 {
@@ -77,8 +79,33 @@ namespace Breeze
         bool showSymbol(SolidButtonStateInfo state) const override;
 
     private:
+        // Colors of a state, each one computed on first use, Qt::NoBrush until then
+        struct StateColors
+        {
+            quint32 generation = 0; // Table generation the colors belong to
+            QBrush background;
+            QBrush border;
+            QBrush symbol;
+        };
+
+        /**
+         * The table is keyed on the title bar color only. While the decoration animates its active state the
+         * color changes every frame, so the painted states are computed once per frame, as without the table.
+         * A title bar color change only bumps the generation, stale entries are reset when next read.
+         *
+         * @return The colors of the state
+         */
+        StateColors &stateColors(const SolidButtonStateInfo &state) const;
+
+        QColor computeBackgroundColor(const SolidButtonStateInfo &state) const;
+
         QColor m_color;
         bool m_hasSymbol;
+
+        // Indexed by the active, hovered, pressed, checked and animated flags of the state
+        mutable std::array<StateColors, 32> m_stateColors;
+        mutable QColor m_stateColorsTitleBarColor; // Title bar color of the table
+        mutable quint32 m_stateColorsGeneration = 1;
     };
 }
 
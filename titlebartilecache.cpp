@@ -0,0 +1,172 @@
+#include "titlebartilecache.h"
+
+#include <QPainter>
+
+#include <cmath>
+
+
+namespace Breeze
+{
+    namespace
+    {
+        // A few title bar heights and radii at the scales of the screens
+        const int g_maxMasks = 16;
+
+        // Cost is the size in bytes, a few hundred title bar colors of usual heights
+        const int g_maxTilesCost = 2 * 1024 * 1024;
+
+        QImage createImage(int width, int height, qreal devicePixelRatio)
+        {
+            QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+            image.setDevicePixelRatio(devicePixelRatio);
+            image.fill(Qt::transparent);
+            return image;
+        }
+
+        /**
+         * @return A copy of the mask tinted with a brush
+         */
+        QImage tint(const QImage &mask, const QBrush &brush)
+        {
+            QImage image(mask);
+            QPainter painter(&image);
+            painter.setCompositionMode(QPainter::CompositionMode_SourceIn);
+            painter.fillRect(QRectF(QPointF(0, 0), QSizeF(image.size()) / image.devicePixelRatio()), brush);
+            return image;
+        }
+    }
+
+    TitleBarTileCache *TitleBarTileCache::self()
+    {
+        static TitleBarTileCache s_self;
+        return &s_self;
+    }
+
+    TitleBarTileCache::TitleBarTileCache()
+        : m_masks(g_maxMasks)
+        , m_tiles(g_maxTilesCost)
+    {
+    }
+
+    QLinearGradient TitleBarTileCache::gradient(const Key &key)
+    {
+        const QColor color = QColor::fromRgba(key.color);
+        const qreal height = static_cast<qreal>(key.height);
+
+        // Light border at the top
+        QLinearGradient gradient(0, 0, 0, height);
+        const QColor lightCol(color.lighter(130 + key.intensity));
+        gradient.setColorAt(0.0, lightCol);
+        gradient.setColorAt(0.99 / height, lightCol);
+        gradient.setColorAt(1.0 / height, color.lighter(100 + key.intensity));
+        gradient.setColorAt(1.0, color);
+        return gradient;
+    }
+
+    TitleBarTileCache::Tiles TitleBarTileCache::masks(const MaskKey &key)
+    {
+        if (auto masks = m_masks.object(key))
+            return *masks;
+
+        // At a fractional scale the arc does not end on a device pixel, so each tile is padded
+        // to whole pixels on its inner side and the blits never sample past the arc
+        const int width = static_cast<int>(std::ceil(key.radius * key.devicePixelRatio));
+        const int height = static_cast<int>(std::ceil(key.height * key.devicePixelRatio));
+        const qreal tileWidth = width / key.devicePixelRatio;
+
+        // The rounded rect is wider than both arcs and taller than the title bar,
+        // so each tile only sees one top corner
+        const qreal r = key.radius;
+        const QRectF rect(0, 0, 3 * r, key.height + r);
+
+        Tiles masks;
+        masks.left = createImage(width, height, key.devicePixelRatio);
+        {
+            QPainter painter(&masks.left);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(Qt::white);
+            painter.drawRoundedRect(rect, r, r);
+        }
+
+        masks.right = createImage(width, height, key.devicePixelRatio);
+        {
+            QPainter painter(&masks.right);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(Qt::white);
+            painter.drawRoundedRect(rect.translated(tileWidth - 3 * r, 0), r, r);
+        }
+
+        m_masks.insert(key, new Tiles(masks));
+        return masks;
+    }
+
+    TitleBarTileCache::Tiles TitleBarTileCache::tiles(const Key &key)
+    {
+        if (auto tiles = m_tiles.object(key))
+            return *tiles;
+
+        // The tiles start at the top of the title bar, the gradient is used as is
+        const QBrush brush(TitleBarTileCache::gradient(key));
+
+        Tiles tiles;
+        if (key.radius > 0)
+        {
+            const Tiles masks = this->masks({ key.height, key.radius, key.devicePixelRatio });
+            tiles.left = tint(masks.left, brush);
+            tiles.right = tint(masks.right, brush);
+        }
+
+        tiles.strip = createImage(1, static_cast<int>(std::ceil(key.height * key.devicePixelRatio)), key.devicePixelRatio);
+        {
+            QPainter painter(&tiles.strip);
+            painter.fillRect(QRectF(QPointF(0, 0), QSizeF(tiles.strip.size()) / key.devicePixelRatio), brush);
+        }
+
+        const qint64 cost = tiles.left.sizeInBytes() + tiles.right.sizeInBytes() + tiles.strip.sizeInBytes();
+        m_tiles.insert(key, new Tiles(tiles), static_cast<int>(cost));
+        return tiles;
+    }
+
+    void TitleBarTileCache::fill(QPainter *painter, const QRect &rect, const Key &key, int left, int right)
+    {
+        if (rect.isEmpty())
+            return;
+
+        const Tiles tiles = this->tiles(key);
+        if (key.radius <= 0)
+            left = right = 0;
+
+        // Source rects are in device pixels, their outer sides are on whole pixels and the
+        // inner sides of the corners fall in the padding of the tile
+        const qreal dpr = key.devicePixelRatio;
+        const qreal height = key.height * dpr;
+        painter->drawImage(rect.adjusted(left, 0, -right, 0), tiles.strip, QRectF(0, 0, 1, height));
+
+        if (left > 0)
+        {
+            painter->drawImage(QRect(rect.left(), rect.top(), left, rect.height()), tiles.left,
+                               QRectF(0, 0, left * dpr, height));
+        }
+
+        if (right > 0)
+        {
+            painter->drawImage(QRect(rect.right() + 1 - right, rect.top(), right, rect.height()), tiles.right,
+                               QRectF(tiles.right.width() - right * dpr, 0, right * dpr, height));
+        }
+    }
+
+    uint qHash(const TitleBarTileCache::MaskKey &key, uint seed)
+    {
+        return ::qHash(key.height << 16 | key.radius, seed) ^ ::qHash(key.devicePixelRatio, seed);
+    }
+
+    uint qHash(const TitleBarTileCache::Key &key, uint seed)
+    {
+        uint hash = ::qHash(key.color, seed);
+        hash = hash * 31 + ::qHash(key.height << 16 | key.radius, seed);
+        hash = hash * 31 + ::qHash(key.intensity, seed);
+        return hash * 31 + ::qHash(key.devicePixelRatio, seed);
+    }
+}
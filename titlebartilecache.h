@@ -0,0 +1,122 @@
+#ifndef TITLE_BAR_TILE_CACHE_H
+#define TITLE_BAR_TILE_CACHE_H
+
+/*
+ * Copyright 2020  Alejandro Romero Rivera <k1r0d3v@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License or (at your option) version 3 or any later version
+ * accepted by the membership of KDE e.V. (or its successor approved
+ * by the membership of KDE e.V.), which shall act as a proxy
+ * defined in Section 14 of version 3 of the license.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCache>
+#include <QImage>
+#include <QLinearGradient>
+
+class QPainter;
+
+
+namespace Breeze
+{
+    /**
+     * Process wide cache of the pre-rendered tiles of the title bar backgrounds.
+     * A title bar is painted with a gradient strip stretched over its width and a rounded tile
+     * on each top corner, so a repaint is only blits.
+     *
+     * The tiles are cached per title bar color, the colorless corner masks are kept too so a new
+     * color only tints them.
+     */
+    class TitleBarTileCache
+    {
+    public:
+        // Title bar background
+        struct Key
+        {
+            QRgb color; // Title bar color, with its alpha
+            int height; // Title bar height
+            int radius; // Frame radius
+            int intensity; // Gradient intensity, a flat title bar is a gradient of intensity 0
+            qreal devicePixelRatio;
+
+            bool operator==(const Key &other) const
+            {
+                return color == other.color && height == other.height && radius == other.radius
+                    && intensity == other.intensity && devicePixelRatio == other.devicePixelRatio;
+            }
+        };
+
+        /**
+         * @return The cache instance
+         */
+        static TitleBarTileCache *self();
+
+        /**
+         * Fill the background of a title bar, rounding its top corners
+         *
+         * @param rect The title bar rect, the gradient starts at its top
+         * @param left Width of the rounded top left corner, at most the key radius, 0 for a square corner
+         * @param right Width of the rounded top right corner
+         */
+        void fill(QPainter *painter, const QRect &rect, const Key &key, int left, int right);
+
+        /**
+         * @return The title bar background gradient of the key, in logical coordinates
+         */
+        static QLinearGradient gradient(const Key &key);
+
+    private:
+        TitleBarTileCache();
+
+        struct MaskKey
+        {
+            int height;
+            int radius;
+            qreal devicePixelRatio;
+
+            bool operator==(const MaskKey &other) const
+            {
+                return height == other.height && radius == other.radius && devicePixelRatio == other.devicePixelRatio;
+            }
+        };
+
+        friend uint qHash(const MaskKey &key, uint seed);
+
+        // The full title bar height, the corners are radius wide in whole device pixels with the arcs
+        // against the outer sides
+        struct Tiles
+        {
+            QImage left; // Top left corner
+            QImage right; // Top right corner
+            QImage strip; // One device pixel wide, stretched between the corners
+        };
+
+        /**
+         * @return The corner masks of the key in opaque white, the strip is left null. Rendered on the first request
+         */
+        Tiles masks(const MaskKey &key);
+
+        /**
+         * @return The tiles of the key, tinted with its gradient on the first request
+         */
+        Tiles tiles(const Key &key);
+
+        QCache<MaskKey, Tiles> m_masks;
+        QCache<Key, Tiles> m_tiles;
+    };
+
+    uint qHash(const TitleBarTileCache::Key &key, uint seed = 0);
+}
+
+#endif